@@ -1,8 +1,10 @@
 #pragma once
 
+#include <array>
 #include <memory>
 #include <string_view>
-#include <unordered_map>
+#include "arenaAllocator.hpp"
+#include "builtins.hpp"
 
 using calcFunction = double (*)(double);
 
@@ -74,6 +76,11 @@ class CompiledFunction {
 		return function(arg);
 	}
 
+	// the raw pointer, it stays valid as long as this object owns the jit
+	calcFunction getFunction() const {
+		return function;
+	}
+
 	// Manual destructor for resource cleanup
 	void manualDestructor() {
 		if (lljit.get() != nullptr) {
@@ -91,12 +98,18 @@ class CompiledFunction {
 class JITCompiler {
   public:
 	JITCompiler();
+	~JITCompiler();
+
+	JITCompiler(const JITCompiler& other) = delete;
+	JITCompiler& operator=(const JITCompiler& other) = delete;
+
 	CompiledFunction compile(ExpressionNode* expr);
 
 
   private:
 	llvm::Value* generateCode(ExpressionNode* expr);
-	void createExternalFunction(const std::string_view name);
+	llvm::Function* getBuiltinFunction(Builtin builtin);
+	llvm::CallInst* createBuiltinCall(Builtin builtin, llvm::ArrayRef<llvm::Value*> args);
 
 	llvm::orc::ThreadSafeModule createModule(ExpressionNode* expr);
 	
@@ -106,5 +119,8 @@ class JITCompiler {
 	llvm::Value* variable = nullptr;
 	llvm::FunctionType* funcType = nullptr;
 	
-	std::unordered_map<std::string_view, llvm::Function*> createdFunctions;
+	std::array<llvm::Function*, static_cast<size_t>(Builtin::MAX)> createdFunctions{};
+
+	// scratch memory of one compile job, freed with the compiler
+	Arena jobArena{};
 };
\ No newline at end of file
@@ -0,0 +1,25 @@
+#pragma once
+#include <stddef.h>
+#include <stdio.h>
+
+// Build with COUNT_ALLOCATIONS=1 to count every heap allocation going through the global operator new
+// and the ImGui allocator, together with the call stacks they came from.
+#ifndef COUNT_ALLOCATIONS
+#define COUNT_ALLOCATIONS 0
+#endif
+
+#if COUNT_ALLOCATIONS
+
+struct AllocationCount {
+	size_t allocations;
+	size_t bytes;
+};
+
+// has to be called before ImGui::CreateContext
+void allocationCounterInstallImGuiHooks();
+// returns what was allocated since the previous call
+AllocationCount allocationCounterEndFrame();
+// writes the call sites of all allocations since the previous report, the most frequent first
+void allocationCounterReport(FILE* out);
+
+#endif
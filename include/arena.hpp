@@ -57,16 +57,85 @@
 
 #define REGION_DEFAULT_CAPACITY (8 * 1024)
 
+// The virtual memory backends reserve at least this many words per region and commit them on demand,
+// so an arena normally never needs a second region.
+#ifndef ARENA_RESERVE_WORDS
+#define ARENA_RESERVE_WORDS ((size_t)1 << 27) // 1 GiB
+#endif
+
+#ifndef ARENA_USE_HUGE_PAGES
+#define ARENA_USE_HUGE_PAGES 0
+#endif
+
+// bytes committed at once, a multiple of the page size (and of the huge page size when those are used)
+#ifndef ARENA_COMMIT_GRANULARITY
+#if ARENA_USE_HUGE_PAGES
+#define ARENA_COMMIT_GRANULARITY ((size_t)2 * 1024 * 1024)
+#else
+#define ARENA_COMMIT_GRANULARITY ((size_t)64 * 1024)
+#endif
+#endif
+
+// Collects where and how the arenas allocate, on by default outside production builds
+#ifndef ARENA_STATS
+#if PRODUCTION_BUILD == 0
+#define ARENA_STATS 1
+#else
+#define ARENA_STATS 0
+#endif
+#endif
+
+#define ARENA_MAX_TAGS 16
+
+struct ArenaTagStats {
+	const char* name;
+	size_t allocations;
+	size_t frame_bytes;		 // since the last arena_reset
+	size_t last_frame_bytes; // frame_bytes before the last arena_reset
+	size_t total_bytes;
+};
+
+struct ArenaStats {
+	size_t new_regions;		 // regions added after arena_init
+	size_t skipped_regions;	 // regions passed over because the allocation did not fit anymore
+	size_t oversize_allocs;	 // allocations larger than REGION_DEFAULT_CAPACITY
+	size_t frame_bytes;		 // allocated since the last arena_reset
+	size_t last_frame_bytes; // frame_bytes before the last arena_reset
+	size_t peak_used_bytes;	 // most bytes in use at once, seen at arena_reset and arena_rewind
+	size_t current_tag;		 // index into tags, 0 is everything allocated without a tag
+	size_t tag_count;
+	ArenaTagStats tags[ARENA_MAX_TAGS];
+};
+
 struct Region {
 	Region* next;
 	size_t count;
-	size_t capacity;
+	size_t capacity;  // reserved words
+	size_t committed; // words that can be used without committing more pages
 	uintptr_t data[1]; // flexiable member
 };
 
 struct Arena {
 	Region* begin = nullptr;
 	Region* end = nullptr;
+	// bytes left behind by arena_realloc when it could not grow in place, never reset
+	size_t realloc_wasted_bytes = 0;
+	// state of arena_reset_and_trim
+	size_t high_water_bytes = 0;
+	size_t peak_rewound_bytes = 0; // usage before the largest arena_rewind since the last reset
+	size_t frames_below_threshold = 0;
+#if ARENA_STATS
+	ArenaStats stats = {};
+#endif
+};
+
+// When an arena that is reset every frame stays well below its committed memory for a while,
+// the memory above the decaying high-water mark is given back to the OS.
+struct ArenaTrimPolicy {
+	float decay = 0.98f;		   // the high-water mark falls by this factor every frame when usage is lower
+	float threshold = 0.5f;		   // trimming starts when the high-water mark is below this part of the committed memory
+	size_t frames = 300;		   // frames in a row the arena has to stay below the threshold
+	size_t min_keep_bytes = 1 << 20; // never trimmed below this
 };
 
 struct ArenaSnapshot {
@@ -75,6 +144,8 @@ struct ArenaSnapshot {
 };
 
 void* arena_alloc(Arena* a, size_t size_bytes);
+// align has to be a power of two, alignments up to sizeof(uintptr_t) are what arena_alloc gives anyway
+void* arena_alloc_aligned(Arena* a, size_t size_bytes, size_t align);
 void* arena_realloc(Arena* a, void* oldptr, size_t oldsz, size_t newsz);
 char* arena_strdup(Arena* a, const char* cstr);
 void* arena_memdup(Arena* a, void* data, size_t size);
@@ -84,10 +155,28 @@ char* arena_sprintf(Arena* a, const char* format, ...);
 
 void arena_init(Arena* a, size_t reservedCapacity = REGION_DEFAULT_CAPACITY);
 Arena arena_init(size_t reservedCapacity = REGION_DEFAULT_CAPACITY);
-Region* new_region(size_t capacity);
+// capacity words are committed right away, reserve_words is what the region can grow to, 0 for ARENA_RESERVE_WORDS
+Region* new_region(size_t capacity, size_t reserve_words = 0);
 void arena_free(Arena* a);
 void arena_reset(Arena* a);
+ArenaSnapshot arena_snapshot(Arena* a);
+// frees everything allocated after the snapshot was taken
+void arena_rewind(Arena* a, ArenaSnapshot snapshot);
+// arena_reset for arenas reset once per frame, trims them according to policy
+void arena_reset_and_trim(Arena* a, const ArenaTrimPolicy* policy);
+// keeps keep_bytes committed and gives back the rest, regions that are not needed anymore are freed.
+// only valid right after arena_reset
+void arena_trim(Arena* a, size_t keep_bytes);
 void free_region(Region* r);
+// commits the pages of words starting at first_word without touching r->committed.
+// Safe to call from several threads at once, for regions shared by a ConcurrentArena
+void region_commit_range(Region* r, size_t first_word, size_t words);
+
+// following allocations are counted under tag until the next call, returns the previous tag.
+// tag has to outlive the arena, a string literal is best. Without ARENA_STATS these do nothing
+const char* arena_set_tag(Arena* a, const char* tag);
+// writes the stats as one JSON object into buffer and returns the length snprintf would have written
+int arena_stats_json(const Arena* a, const char* name, char* buffer, size_t buffer_size);
 
 #define ARENA_DA_INIT_CAP 256
 
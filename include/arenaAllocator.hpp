@@ -1,7 +1,11 @@
 #pragma once
 #include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
 #include "arena.hpp"
 
+// per-frame scratch arena, reset at the end of every gameLogic
 extern Arena global_arena;
 
 template <typename T> class ArenaAllocator {
@@ -10,8 +14,16 @@ template <typename T> class ArenaAllocator {
 	using size_type = std::size_t;
 	using difference_type = std::ptrdiff_t;
 
-	// Default constructor using the global static Arena
-	ArenaAllocator() noexcept {};
+	// a container moved or swapped takes its arena with it instead of copying into the arena of the target
+	using propagate_on_container_move_assignment = std::true_type;
+	using propagate_on_container_swap = std::true_type;
+
+	// Default constructor using the per-frame arena
+	ArenaAllocator() noexcept : arena(&global_arena) {
+	}
+
+	explicit ArenaAllocator(Arena* arena) noexcept : arena(arena) {
+	}
 
 	~ArenaAllocator() noexcept {
 	}
@@ -21,16 +33,16 @@ template <typename T> class ArenaAllocator {
 		using other = ArenaAllocator<U>;
 	};
 
-	template <typename U> ArenaAllocator(const ArenaAllocator<U>&) noexcept {
-	}
-
-	template <typename U, typename = std::enable_if_t<std::is_same_v<U, ArenaAllocator<typename U::value_type>>>>
-	operator U() const noexcept {
-		return U();
+	template <typename U> ArenaAllocator(const ArenaAllocator<U>& other) noexcept : arena(other.arena) {
 	}
 
 	[[nodiscard]] T* allocate(size_type n) {
-		void* ptr = arena_alloc(&global_arena, n * sizeof(T));
+		void* ptr = nullptr;
+		if constexpr (alignof(T) > sizeof(uintptr_t)) {
+			ptr = arena_alloc_aligned(arena, n * sizeof(T), alignof(T));
+		} else {
+			ptr = arena_alloc(arena, n * sizeof(T));
+		}
 		if (!ptr) {
 			throw std::bad_alloc();
 		}
@@ -38,15 +50,191 @@ template <typename T> class ArenaAllocator {
 	}
 
 	void deallocate(T* p, size_type n) noexcept {
-		// No-op, memory is managed by the global arena
+		// No-op, memory is managed by the arena.
+		// The arena is not touched here, a container may outlive it while its owner is moved
 	}
 
-	// Equality comparison for allocators (always true as the arena is global)
+	// memory of one arena can only be handed to containers using the same arena
 	bool operator==(const ArenaAllocator& other) const noexcept {
-		return true;
+		return arena == other.arena;
 	}
 
 	bool operator!=(const ArenaAllocator& other) const noexcept {
 		return !(*this == other);
 	}
-};
\ No newline at end of file
+
+	Arena* arena;
+};
+
+// A growable array of trivially copyable T in an arena. std::vector always moves to a new buffer when it grows, this
+// grows with arena_realloc instead, which extends the buffer in place while it is the last allocation of the arena.
+// Neither destroying nor moving it touches the arena, so it may outlive the arena as long as it is not used anymore.
+template <typename T> class ArenaVector {
+	static_assert(std::is_trivially_copyable_v<T>, "ArenaVector copies its items with memcpy");
+	static_assert(alignof(T) <= sizeof(uintptr_t), "ArenaVector only has the alignment of arena_alloc");
+
+  public:
+	explicit ArenaVector(Arena* arena = &global_arena) noexcept : arena(arena) {
+	}
+
+	ArenaVector(const ArenaVector& other) = delete;
+	ArenaVector& operator=(const ArenaVector& other) = delete;
+
+	ArenaVector(ArenaVector&& other) noexcept
+		: arena(other.arena), items(other.items), count(other.count), capacity(other.capacity) {
+		other.items = nullptr;
+		other.count = 0;
+		other.capacity = 0;
+	}
+
+	ArenaVector& operator=(ArenaVector&& other) noexcept {
+		std::swap(arena, other.arena);
+		std::swap(items, other.items);
+		std::swap(count, other.count);
+		std::swap(capacity, other.capacity);
+		return *this;
+	}
+
+	void reserve(size_t n) {
+		if (n <= capacity) {
+			return;
+		}
+		void* grown = arena_realloc(arena, items, capacity * sizeof(T), n * sizeof(T));
+		if (grown == nullptr) {
+			throw std::bad_alloc();
+		}
+		items = static_cast<T*>(grown);
+		capacity = n;
+	}
+
+	void resize(size_t n) {
+		if (n > capacity) {
+			reserve(n > capacity * 2 ? n : capacity * 2);
+		}
+		count = n;
+	}
+
+	void assign(const T* first, const T* last) {
+		resize(static_cast<size_t>(last - first));
+		if (count != 0) {
+			memcpy(items, first, count * sizeof(T));
+		}
+	}
+
+	void push_back(const T& item) {
+		if (count == capacity) {
+			reserve(capacity == 0 ? initialCapacity : capacity * 2);
+		}
+		items[count++] = item;
+	}
+
+	void pop_back() noexcept {
+		count--;
+	}
+
+	// keeps the capacity
+	void clear() noexcept {
+		count = 0;
+	}
+
+	T* data() noexcept {
+		return items;
+	}
+	const T* data() const noexcept {
+		return items;
+	}
+	size_t size() const noexcept {
+		return count;
+	}
+	bool empty() const noexcept {
+		return count == 0;
+	}
+	T& operator[](size_t i) noexcept {
+		return items[i];
+	}
+	const T& operator[](size_t i) const noexcept {
+		return items[i];
+	}
+	T& back() noexcept {
+		return items[count - 1];
+	}
+	const T& back() const noexcept {
+		return items[count - 1];
+	}
+	T* begin() noexcept {
+		return items;
+	}
+	T* end() noexcept {
+		return items + count;
+	}
+	const T* begin() const noexcept {
+		return items;
+	}
+	const T* end() const noexcept {
+		return items + count;
+	}
+
+  private:
+	static constexpr size_t initialCapacity = 64;
+
+	Arena* arena;
+	T* items = nullptr;
+	size_t count = 0;
+	size_t capacity = 0;
+};
+
+// Frees everything allocated from the arena during its lifetime when it goes out of scope.
+// A container created before the scope must not grow inside it, its new buffer would be freed as well
+class ArenaScope {
+  public:
+	explicit ArenaScope(Arena* arena = &global_arena) noexcept : arena(arena), snapshot(arena_snapshot(arena)) {
+	}
+
+	~ArenaScope() noexcept {
+		arena_rewind(arena, snapshot);
+	}
+
+	ArenaScope(const ArenaScope& other) = delete;
+	ArenaScope& operator=(const ArenaScope& other) = delete;
+
+  private:
+	Arena* arena;
+	ArenaSnapshot snapshot;
+};
+
+// counts the allocations of its lifetime under tag in the arena stats
+class ArenaTag {
+  public:
+	explicit ArenaTag(const char* tag, Arena* arena = &global_arena) noexcept
+		: arena(arena), previous(arena_set_tag(arena, tag)) {
+	}
+
+	~ArenaTag() noexcept {
+		arena_set_tag(arena, previous);
+	}
+
+	ArenaTag(const ArenaTag& other) = delete;
+	ArenaTag& operator=(const ArenaTag& other) = delete;
+
+  private:
+	Arena* arena;
+	const char* previous;
+};
+
+struct ArenaDeleter {
+	void operator()(Arena* a) const noexcept {
+		if (a->begin != nullptr) {
+			arena_free(a);
+		}
+		delete a;
+	}
+};
+
+// an arena with a fixed address, so allocators pointing to it stay valid when the owner is moved
+using ArenaPtr = std::unique_ptr<Arena, ArenaDeleter>;
+
+inline ArenaPtr makeArena(size_t reservedCapacity = REGION_DEFAULT_CAPACITY) {
+	ArenaPtr arena(new Arena{});
+	arena_init(arena.get(), reservedCapacity);
+	return arena;
+}
@@ -0,0 +1,168 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <string_view>
+#include "defines.hpp"
+
+// Every identifier the language knows about. The lexer resolves identifiers to this once,
+// after that no stage has to compare or hash names again.
+enum class Builtin : uint8_t {
+	None, // an identifier that is not a builtin
+	X,
+	E,
+	Pi,
+	Sin,
+	Cos,
+	Tan,
+	Acos,
+	Asin,
+	Atan,
+	Cosh,
+	Sinh,
+	Tanh,
+	Log,
+	Log10,
+	Sqrt,
+	Ceil,
+	Fabs,
+	Floor,
+	Round,
+	Pow,
+	MAX
+};
+
+enum class BuiltinKind : uint8_t {
+	None,
+	Variable,
+	Constant,
+	Function,
+};
+
+// the LLVM intrinsic a function maps onto, the JIT translates these to llvm::Intrinsic ids
+enum class BuiltinIntrinsic : uint8_t {
+	None, // called as an external libm function
+	Sin,
+	Cos,
+	Log,
+	Log10,
+	Sqrt,
+	Ceil,
+	Fabs,
+	Floor,
+	Round,
+	Pow,
+};
+
+struct BuiltinInfo {
+	std::string_view name;
+	BuiltinKind kind;
+	uint8_t arity;
+	bool isPure; // result depends only on the arguments, so calls can be folded and reordered
+	BuiltinIntrinsic intrinsic;
+	double value; // only for constants
+	// 4 wide double variant in the platform vector math library, empty if there is none
+	std::string_view vectorVariant;
+};
+
+#if PLATFORM_WIN
+#define BUILTIN_VECTOR_VARIANT(libmvecName, msvcName) msvcName
+#else
+#define BUILTIN_VECTOR_VARIANT(libmvecName, msvcName) libmvecName
+#endif
+
+// indexed by Builtin, the order has to match the enum
+inline constexpr BuiltinInfo builtinTable[] = {
+	{"", BuiltinKind::None, 0, false, BuiltinIntrinsic::None, 0.0, ""},
+	{"x", BuiltinKind::Variable, 0, true, BuiltinIntrinsic::None, 0.0, ""},
+	{"e", BuiltinKind::Constant, 0, true, BuiltinIntrinsic::None, 2.718281828459045235360, ""},
+	{"pi", BuiltinKind::Constant, 0, true, BuiltinIntrinsic::None, 3.14159265358979323846, ""},
+	{"sin", BuiltinKind::Function, 1, true, BuiltinIntrinsic::Sin, 0.0,
+	 BUILTIN_VECTOR_VARIANT("_ZGVdN4v_sin", "__vdecl_sin4")},
+	{"cos", BuiltinKind::Function, 1, true, BuiltinIntrinsic::Cos, 0.0,
+	 BUILTIN_VECTOR_VARIANT("_ZGVdN4v_cos", "__vdecl_cos4")},
+	{"tan", BuiltinKind::Function, 1, true, BuiltinIntrinsic::None, 0.0, ""},
+	{"acos", BuiltinKind::Function, 1, true, BuiltinIntrinsic::None, 0.0, ""},
+	{"asin", BuiltinKind::Function, 1, true, BuiltinIntrinsic::None, 0.0, ""},
+	{"atan", BuiltinKind::Function, 1, true, BuiltinIntrinsic::None, 0.0, ""},
+	{"cosh", BuiltinKind::Function, 1, true, BuiltinIntrinsic::None, 0.0, ""},
+	{"sinh", BuiltinKind::Function, 1, true, BuiltinIntrinsic::None, 0.0, ""},
+	{"tanh", BuiltinKind::Function, 1, true, BuiltinIntrinsic::None, 0.0, ""},
+	{"log", BuiltinKind::Function, 1, true, BuiltinIntrinsic::Log, 0.0,
+	 BUILTIN_VECTOR_VARIANT("_ZGVdN4v_log", "__vdecl_log4")},
+	{"log10", BuiltinKind::Function, 1, true, BuiltinIntrinsic::Log10, 0.0, ""},
+	{"sqrt", BuiltinKind::Function, 1, true, BuiltinIntrinsic::Sqrt, 0.0, ""},
+	{"ceil", BuiltinKind::Function, 1, true, BuiltinIntrinsic::Ceil, 0.0, ""},
+	{"fabs", BuiltinKind::Function, 1, true, BuiltinIntrinsic::Fabs, 0.0, ""},
+	{"floor", BuiltinKind::Function, 1, true, BuiltinIntrinsic::Floor, 0.0, ""},
+	{"round", BuiltinKind::Function, 1, true, BuiltinIntrinsic::Round, 0.0, ""},
+	// only reachable through the ^ operator, the parser rejects pow(...) since it takes 2 arguments
+	{"pow", BuiltinKind::Function, 2, true, BuiltinIntrinsic::Pow, 0.0,
+	 BUILTIN_VECTOR_VARIANT("_ZGVdN4vv_pow", "__vdecl_pow4")},
+};
+
+#undef BUILTIN_VECTOR_VARIANT
+
+static_assert(std::size(builtinTable) == static_cast<size_t>(Builtin::MAX), "builtinTable does not match Builtin");
+
+constexpr const BuiltinInfo& getBuiltinInfo(Builtin builtin) {
+	return builtinTable[static_cast<size_t>(builtin)];
+}
+
+#pragma region perfect hash
+
+// The seed is searched at compile time so that every builtin name lands in its own slot,
+// a lookup is then one hash, one table load and one string compare.
+constexpr size_t builtinHashTableSize = 64;
+
+constexpr uint32_t builtinHash(std::string_view name, uint32_t seed) {
+	uint32_t hash = seed ^ static_cast<uint32_t>(name.size());
+	for (char c : name) {
+		hash = (hash ^ static_cast<uint8_t>(c)) * 16777619u; // FNV-1a prime
+	}
+	return (hash ^ (hash >> 15)) % builtinHashTableSize;
+}
+
+constexpr bool builtinHashSeedIsPerfect(uint32_t seed) {
+	bool used[builtinHashTableSize] = {};
+	for (size_t i = 1; i < std::size(builtinTable); i++) {
+		const uint32_t slot = builtinHash(builtinTable[i].name, seed);
+		if (used[slot]) {
+			return false;
+		}
+		used[slot] = true;
+	}
+	return true;
+}
+
+constexpr uint32_t findBuiltinHashSeed() {
+	for (uint32_t seed = 2166136261u; seed < 2166136261u + 10000; seed++) {
+		if (builtinHashSeedIsPerfect(seed)) {
+			return seed;
+		}
+	}
+	return 0;
+}
+
+inline constexpr uint32_t builtinHashSeed = findBuiltinHashSeed();
+static_assert(builtinHashSeed != 0, "no perfect hash seed was found, increase builtinHashTableSize");
+
+constexpr std::array<Builtin, builtinHashTableSize> makeBuiltinHashTable() {
+	std::array<Builtin, builtinHashTableSize> table{};
+	for (size_t i = 1; i < std::size(builtinTable); i++) {
+		table[builtinHash(builtinTable[i].name, builtinHashSeed)] = static_cast<Builtin>(i);
+	}
+	return table;
+}
+
+inline constexpr std::array<Builtin, builtinHashTableSize> builtinHashTable = makeBuiltinHashTable();
+
+constexpr Builtin lookupBuiltin(std::string_view name) {
+	const Builtin candidate = builtinHashTable[builtinHash(name, builtinHashSeed)];
+	return getBuiltinInfo(candidate).name == name ? candidate : Builtin::None;
+}
+
+static_assert(lookupBuiltin("sin") == Builtin::Sin && lookupBuiltin("pi") == Builtin::Pi &&
+				  lookupBuiltin("log10") == Builtin::Log10 && lookupBuiltin("sinx") == Builtin::None,
+			  "perfect hash lookup is broken");
+
+#pragma endregion
@@ -0,0 +1,46 @@
+#pragma once
+#include <cstddef>
+#include "curveSampler.hpp"
+
+struct ExpressionNode;
+
+struct ProxyStats {
+	size_t evaluations = 0; // of func, for fitting and checking
+	size_t intervalEvaluations = 0;
+	size_t pieces = 0;
+	size_t failedPieces = 0; // left to func
+};
+
+// A piecewise Chebyshev interpolant of func over one x range, so the sampler can take as many samples of an
+// expensive curve as it likes for the cost of a polynomial. A piece interpolates func at the Chebyshev points of
+// its range and is only kept if its last coefficients have decayed below the tolerance and it is within the
+// tolerance of func at the points halfway between the nodes, where the error of the interpolant peaks. Pieces that
+// fail are halved down to a minimum width and left to func after that, so do ranges the interval bounds show to
+// have a pole, a jump, a kink or no value in them.
+class ChebyshevProxy {
+  public:
+	static constexpr int DEGREE = 16;
+	static constexpr int MAX_DEPTH = 4; // a piece is at least 1 / 16 of the range
+	static constexpr size_t MAX_PIECES = size_t(1) << MAX_DEPTH;
+
+	// tolerance is in units of y, bounds is optional
+	ProxyStats fit(calcFunction func, const IntervalFunction* bounds, double xMin, double xMax, double tolerance);
+	// false outside of the range and in pieces that did not fit, func is evaluated there
+	bool evaluate(double x, double& y) const;
+
+  private:
+	struct Piece {
+		double xMin;
+		double xMax;
+		bool fitted;
+		double coefficients[DEGREE + 1];
+	};
+	void fitPiece(calcFunction func, const IntervalFunction* bounds, double x0, double x1, int depth,
+				  double tolerance, ProxyStats& stats);
+
+	Piece pieces[MAX_PIECES];
+	size_t pieceCount = 0;
+};
+
+// true for expressions with enough calls into libm that the proxy is cheaper than evaluating them
+bool isWorthProxying(const ExpressionNode* root);
@@ -0,0 +1,29 @@
+#pragma once
+#include <atomic>
+#include <mutex>
+#include "arena.hpp"
+
+// words a thread takes from the shared region at once
+#define CONCURRENT_ARENA_CHUNK_WORDS (8 * 1024)
+
+// An arena that many threads can allocate from without locks. Every thread bumps a pointer in a chunk
+// of its own, the chunks are carved from one shared region with an atomic fetch-add.
+// Reset and free must only happen while no thread allocates, at a frame barrier.
+struct ConcurrentArena {
+	Region* region = nullptr;
+	std::atomic<size_t> used{0}; // words handed out as chunks
+	// words from the start of the region that are committed, only grows, pages stay committed over resets
+	std::atomic<size_t> committed{0};
+	std::mutex commit_mutex; // taken only to commit past committed
+	// changes with every reset, so chunks that threads still hold from before are not used anymore
+	std::atomic<uint64_t> generation{0};
+	size_t chunk_words = CONCURRENT_ARENA_CHUNK_WORDS;
+};
+
+// capacity is the words reserved for the arena, only the first chunk is committed up front
+void concurrent_arena_init(ConcurrentArena* a, size_t capacity = ARENA_RESERVE_WORDS,
+						   size_t chunk_words = CONCURRENT_ARENA_CHUNK_WORDS);
+// returns NULL when the region is used up
+void* concurrent_arena_alloc(ConcurrentArena* a, size_t size_bytes);
+void concurrent_arena_reset(ConcurrentArena* a);
+void concurrent_arena_free(ConcurrentArena* a);
@@ -0,0 +1,87 @@
+#pragma once
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "arenaAllocator.hpp"
+
+// same signature as the functions the JIT compiler produces
+using calcFunction = double (*)(double);
+
+class IntervalFunction;
+class ChebyshevProxy;
+
+using SampleVector = ArenaVector<glm::vec2>;
+
+// the part of the world that is sampled and how big one pixel of it is
+struct SampleView {
+	double xMin = -1.0;
+	double xMax = 1.0;
+	// only used to stop refining where the curve is off screen
+	double yMin = -1.0;
+	double yMax = 1.0;
+	double pixelsPerUnitX = 1.0;
+	double pixelsPerUnitY = 1.0;
+
+	// samples are written as (p - anchor) * outputScale
+	glm::dvec2 anchor = {0.0, 0.0};
+	double outputScale = 1.0;
+};
+
+struct SamplerSettings {
+	// how far the midpoint of a segment may be from its chord before the segment is split
+	float maxPixelError = 0.5f;
+	// segments narrower than this are never split, more samples in one pixel column are not visible
+	float minSegmentPixels = 0.5f;
+	// width of the segments the recursion starts from, narrow enough to not step over a whole wiggle
+	float initialSegmentPixels = 16.0f;
+	int maxDepth = 12;
+	size_t sampleBudget = 16384; // per curve, never more samples than this
+	// jumps higher than this at the finest segments end the line strip
+	float jumpPixels = 2.0f;
+	// evaluations to find one edge of a NaN run or one jump
+	int maxBisections = 24;
+	// more turns of the curve than this per pixel column switch to the min/max envelope,
+	// at this density the line strip would only draw noise
+	float envelopeTurnsPerPixel = 0.5f;
+	// evaluations per pixel column of the envelope
+	int envelopeSamplesPerColumn = 16;
+	// tiles of an expensive curve are sampled from a piecewise polynomial within this of it where one fits
+	bool chebyshevProxy = false;
+	float proxyTolerancePixels = 0.05f;
+};
+
+struct SampleStats {
+	size_t evaluations = 0;
+	size_t samples = 0;
+	size_t breaks = 0;
+	size_t turns = 0;	   // of the curve by more than maxPixelError
+	bool envelope = false; // sampled as min/max columns
+	size_t intervalEvaluations = 0;
+	size_t proxyEvaluations = 0; // taken from the proxy instead of func
+};
+
+// samples are drawn as line strips, a break sample ends one strip and starts the next at a pole,
+// a jump or a NaN run
+inline constexpr glm::vec2 sampleBreak = {NAN, NAN};
+
+inline bool isSampleBreak(glm::vec2 sample) {
+	return sample.x != sample.x;
+}
+
+// splits samples at their breaks into strips of at least two samples,
+// firsts and counts need room for count / 2 + 1 strips, returns the number of strips
+size_t findSampleStrips(const glm::vec2* samples, size_t count, int32_t* firsts, int32_t* counts);
+
+// Samples func over [view.xMin, view.xMax] by recursive subdivision until every segment is within
+// settings.maxPixelError of the curve on screen. Jumps and NaN or infinite runs become breaks. out is cleared first.
+// A curve that turns more often than settings.envelopeTurnsPerPixel is sampled again as the min and max of every
+// pixel column instead, drawn as vertical spans joined in a zigzag, so its cost does not grow with the frequency.
+// bounds is optional, segments it proves to be off screen, flat or without a value are not refined and
+// steep segments it proves to be continuous are not searched for a jump.
+// proxy is optional, it stands in for func wherever it has a fitted piece.
+SampleStats sampleCurve(calcFunction func, const IntervalFunction* bounds, const ChebyshevProxy* proxy,
+						const SampleView& view, const SamplerSettings& settings, SampleVector& out);
+
+// compares the samples per curve of the old fixed step sampler with sampleCurve and logs them
+void curveSamplerDebugBenchmark(int framebufferWidth, int framebufferHeight);
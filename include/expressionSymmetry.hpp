@@ -0,0 +1,24 @@
+#pragma once
+
+struct ExpressionNode;
+
+enum class Parity : signed char {
+	Odd = -1,
+	None = 0,
+	Even = 1,
+};
+
+// what is known about f for every x from the shape of its expression alone
+struct ExpressionSymmetry {
+	// f(x + period) == f(x), 0 if no period is known
+	double period = 0.0;
+	// f(-x) == f(x) for even, f(-x) == -f(x) for odd
+	Parity parity = Parity::None;
+};
+
+// Finds a period and a parity that hold by construction: sin, cos and tan of an affine argument are periodic,
+// sums and products of periodic parts share a period if theirs are small multiples of each other, and parity
+// follows the usual rules for sums, products, powers and odd or even functions. Anything it cannot prove is
+// left out, a curve without symmetry is sampled the normal way. Follows the rewrites of the JIT, so it is about
+// the function that is actually evaluated.
+ExpressionSymmetry analyzeSymmetry(const ExpressionNode* root);
@@ -0,0 +1,47 @@
+#pragma once
+#include "arena.hpp"
+#include "lexer.hpp"
+#include "parser.hpp"
+#include <string>
+#include <vector>
+
+// Keeps the tokens and the tree of the previous parse of one expression.
+// After an edit only the tokens around the changed text are lexed again, and every subtree
+// whose tokens did not change is taken from the memo instead of being parsed again.
+class IncrementalParser {
+  public:
+	IncrementalParser() = default;
+	~IncrementalParser();
+
+	IncrementalParser(const IncrementalParser& other) = delete;
+	IncrementalParser& operator=(const IncrementalParser& other) = delete;
+	IncrementalParser(IncrementalParser&& other) noexcept;
+	IncrementalParser& operator=(IncrementalParser&& other) noexcept;
+
+	// returns nullptr if the expression has an error
+	// the tree stays valid until the next call
+	ExpressionNode* parse(const std::string& input);
+
+	void clear();
+
+	const Arena& getNodeArena() const {
+		return nodeArena;
+	}
+
+  private:
+	void lexAll();
+	void relex();
+	ExpressionNode* runParser();
+
+	std::string cleanExpression;
+	std::string scratchExpression;
+	std::vector<Token> tokens;
+	std::vector<Token> scratchTokens;
+	ParseMemo memo;
+	Arena nodeArena{};
+
+	ExpressionNode* tree = nullptr;
+	bool hasError = true;
+	int parenthesesBalance = 0;
+	size_t memoEntriesAfterRebuild = 0;
+};
@@ -0,0 +1,59 @@
+#pragma once
+#include <cmath>
+#include <cstddef>
+#include <vector>
+#include "builtins.hpp"
+
+struct ExpressionNode;
+enum class NodeType;
+
+// A closed range of doubles. lo > hi is the empty interval, the function has no value anywhere in the input.
+struct Interval {
+	double lo = INFINITY;
+	double hi = -INFINITY;
+
+	bool isEmpty() const {
+		return !(lo <= hi);
+	}
+	bool isBounded() const {
+		return std::isfinite(lo) && std::isfinite(hi);
+	}
+};
+
+// bounds of f and of its derivative over an x range
+struct IntervalBounds {
+	Interval value;
+	// unbounded where f may not be differentiable, at a pole, a jump or a kink
+	Interval slope;
+	// f has no value at some of the points, like log of the negative part of its argument
+	bool partial = false;
+};
+
+// The expression of a graph in interval arithmetic next to the compiled eval: for an input [a, b] it gives a
+// range that holds f(x) and f'(x) for every x in it. The ranges are rounded outwards, so they are guaranteed
+// but can be wider than the real ones, the wider the input the more.
+// The tree is flattened into postfix code, evaluate only reads it and can run on several threads at once.
+class IntervalFunction {
+  public:
+	// flattens root, false if the expression is too deep for evaluate, the function is empty then
+	bool compile(const ExpressionNode* root);
+	void clear();
+
+	bool isEmpty() const {
+		return code.empty();
+	}
+
+	IntervalBounds evaluate(double xLo, double xHi) const;
+
+  private:
+	static constexpr size_t maxStack = 64;
+
+	struct Instruction {
+		NodeType type;
+		Builtin builtin;
+		double number;
+	};
+	bool emitCode(const ExpressionNode* node, size_t depth);
+
+	std::vector<Instruction> code;
+};
@@ -1,10 +1,13 @@
 #pragma once
 
+#include <array>
+#include <cstdint>
 #include <string>
 #include <string_view>
 #include <vector>
 #include <optional>
 #include <arenaAllocator.hpp>
+#include "builtins.hpp"
 
 enum class TokenType {
 	Error,
@@ -22,39 +25,77 @@ enum class TokenType {
 	MAX
 };
 
+// character classes, a replacement for the <ctype.h> functions which are locale dependent
+// and were called through a function pointer for every character
+enum CharClass : uint8_t {
+	CharClassDigit = 1 << 0,
+	CharClassAlpha = 1 << 1,
+	CharClassSpace = 1 << 2,
+	CharClassHexDigit = 1 << 3,
+	CharClassIdent = CharClassDigit | CharClassAlpha,
+};
+
+constexpr std::array<uint8_t, 256> makeCharClassTable() {
+	std::array<uint8_t, 256> table{};
+	for (int c = '0'; c <= '9'; c++) {
+		table[c] |= CharClassDigit | CharClassHexDigit;
+	}
+	for (int c = 'a'; c <= 'f'; c++) {
+		table[c] |= CharClassHexDigit;
+		table[c - 'a' + 'A'] |= CharClassHexDigit;
+	}
+	for (int c = 'a'; c <= 'z'; c++) {
+		table[c] |= CharClassAlpha;
+		table[c - 'a' + 'A'] |= CharClassAlpha;
+	}
+	for (char c : {' ', '\t', '\n', '\v', '\f', '\r'}) {
+		table[static_cast<unsigned char>(c)] |= CharClassSpace;
+	}
+	return table;
+}
+
+inline constexpr std::array<uint8_t, 256> charClassTable = makeCharClassTable();
+
+constexpr bool isCharClass(char c, uint8_t classMask) {
+	return (charClassTable[static_cast<unsigned char>(c)] & classMask) != 0;
+}
+
 struct Token {
 	TokenType type{};
 	std::string_view lexme;
+	Builtin builtin = Builtin::None; // resolved once for identifiers
 };
 
 struct Lexer {
 	std::string cleanExpression;
 	const char* start = nullptr;
 	const char* current = nullptr;
+	const char* end = nullptr; // points at the null terminator of cleanExpression
 	int parenthesesBalance = 0;
 
 	Lexer(const std::string& expression);
+	// lexes an already whitespace free, null terminated text from position without copying it
+	Lexer(std::string_view cleanText, size_t position);
+
+	// copies src into out without any whitespace, 32 bytes at a time when AVX2 is available
+	static void lexerRemoveWhitespace(std::string_view src, std::string& out);
 
 	std::optional<std::vector<Token, ArenaAllocator<Token>>> lexerLexAllTokens();
 
 	inline Token lexerMakeToken(TokenType type);
 
-	// Template function that accepts multiple conditions and checks them in the loop
-	template <typename... Conditions> inline void lexerAdvanceTillConditionFail(Conditions... conditions) {
-		// Lambda to check all conditions
-		auto allConditionsPass = [&](char c) -> bool {
-			return (... || conditions(c)); // Fold expression to apply all conditions
-		};
-
-		// Advance lexer until one condition fails
-		while (allConditionsPass(*current)) {
-			current++;
-		}
-	}
+	// Advance the lexer while the current character is in one of the classes of classMask
+	void lexerAdvanceWhile(uint8_t classMask);
 
 	Token lexerNextToken();
+	// lexes the rest of a number literal whose first digit was already consumed
+	void lexerLexNumber(char firstDigit);
+	// consumes an exponent such as e-9 or p+3, only if it is followed by a digit
+	void lexerLexExponent(char lower, char upper);
 
 	static std::string lexerDebugGetTokenTypeName(TokenType type);
 	static void lexerDebugPrintArray(const std::vector<Token>& tokenArray);
 	static void lexerDebugPrintToken(Token token);
+	// lexes text iterations times and returns the throughput in GB/s
+	static double lexerDebugBenchmark(const std::string& text, size_t iterations = 1);
 };
@@ -0,0 +1,10 @@
+#pragma once
+#include <optional>
+#include <string_view>
+
+// Parses a number literal as produced by the lexer, it consumes exactly the given span and never looks past it.
+// Supported forms:
+//   123  1.5  1.  1e-9  2.5E+3         decimal, with an optional exponent
+//   0x1F  0x1.8p3  0X.8P-1             hexadecimal, with an optional binary exponent
+// The result is always the correctly rounded double and does not depend on the current locale.
+std::optional<double> parseNumber(std::string_view lexme);
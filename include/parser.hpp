@@ -1,10 +1,10 @@
 #pragma once
 #include "arenaAllocator.hpp"
+#include "builtins.hpp"
 #include "lexer.hpp"
 #include <string>
 #include <utility>
 #include <vector>
-#include <unordered_set>
 #include <string_view>
 
 enum class Precedence {
@@ -65,35 +65,84 @@ struct ExpressionNode {
 		} binary;
 
 		struct {
-			std::string_view name;
+			Builtin id;
 			ExpressionNode* argument;
 		} function;
 	};
 };
 
+// The value of a subtree the JIT folds into a constant: numbers and arithmetic on them, without x or a function
+// call. The JIT folds such a power before it rewrites (a ^ b) ^ c, so anything mirroring the compiled function
+// has to as well. False if node is not constant.
+bool foldConstantTree(const ExpressionNode* node, double& value);
+
+struct ParseMemoEntry {
+	ExpressionNode* node;
+	// tokens from the first token of the call, which the entry is stored on, to the token that ended it
+	// for a full result, to the operator the infix loop stopped at for a checkpoint
+	uint32_t length;
+	uint32_t next; // next entry of the same token
+	Precedence precedence;
+	bool isCheckpoint; // a partial result of the infix loop
+	bool hadError;
+};
+
+// Results of earlier parserParseExpression calls so a re-parse after an edit can reuse every subtree
+// whose tokens did not change. Entries are stored on the first token of their call, with lengths relative
+// to it, so inserting or removing tokens only needs the same splice on firstEntry and a lookup only walks
+// the entries of one token.
+struct ParseMemo {
+	static constexpr uint32_t noEntry = UINT32_MAX;
+
+	// full results and checkpoints are kept apart, so neither lookup walks the other kind, newest first
+	struct TokenEntries {
+		uint32_t results = noEntry;
+		uint32_t checkpoints = noEntry;
+	};
+	std::vector<TokenEntries> firstEntry; // one per token
+	std::vector<ParseMemoEntry> entries;
+	// checkpoints are only searched before this token, everything from it on may have changed
+	size_t reuseLimit = 0;
+
+	void clear();
+	void reset(size_t tokenCount);
+	// replaces the entries of the tokens [begin, end) with insertedCount empty tokens
+	// and drops every entry that depended on one of the replaced tokens
+	void splice(size_t begin, size_t end, size_t insertedCount);
+
+	const ParseMemoEntry* findResult(size_t token, Precedence precedence) const;
+	const ParseMemoEntry* findCheckpoint(size_t callStart, Precedence precedence) const;
+	void record(size_t token, const ParseMemoEntry& entry);
+};
+
 typedef struct Parser {
-	ArenaAllocator<ExpressionNode> nodePool;
+	Arena* nodeArena = &global_arena;
 	bool hasError = false;
 
 	Token curr{};
 	Token next{};
-	const std::vector<Token, ArenaAllocator<Token>>& tokenArray;
+	const Token* tokenArray = nullptr;
+	size_t tokenCount = 0;
 	size_t tokenIndex = 0;
+	ParseMemo* memo = nullptr;
 
 	Parser(const std::vector<Token, ArenaAllocator<Token>>& arr);
+	// nodes are allocated in nodeArena, memo is optional and is both used and filled
+	Parser(const Token* tokens, size_t count, Arena* nodeArena, ParseMemo* memo = nullptr);
 	~Parser();
 
 	inline void parserAdvance();
+	inline void parserSeek(size_t index);
+	inline ExpressionNode* parserNewNode();
 
 	ExpressionNode* parserParseNumber();
 	ExpressionNode* parseIdent();
 	ExpressionNode* parserParsePrefixExpr();
 	ExpressionNode* parserParseExpression(Precedence curr_operator_prec = Precedence::MIN);
+	ExpressionNode* parserParseExpressionMemoized(Precedence curr_operator_prec);
 	ExpressionNode* parserParseInfixExpr(Token tk, ExpressionNode* left);
 	ExpressionNode* parseFunctionCall();
 
 	static void parserDebugDumpTree(ExpressionNode* node, size_t indent = 0);
 
-	const static std::unordered_set<std::string_view> functionSet;
-
 } Parser;
\ No newline at end of file
@@ -0,0 +1,22 @@
+#pragma once
+#include <cstddef>
+#include "curveSampler.hpp"
+
+struct SimplifySettings {
+	// how far a dropped vertex may be from the line that is drawn instead, below a pixel nothing changes on screen
+	float tolerancePixels = 0.25f;
+	// clipped segments end this far outside of the band, far enough that the thick line does not reach into it
+	float clipMarginPixels = 8.0f;
+};
+
+struct SimplifyStats {
+	size_t verticesIn = 0;
+	size_t verticesOut = 0;
+};
+
+// Prepares samples written by sampleCurve or TileCache::gather for view before they are uploaded.
+// Segments leaving the band [yMin, yMax] are clipped at its edge plus a margin, so a run of samples above
+// or below it becomes two vertices. Then every strip is simplified by Douglas-Peucker in screen space.
+// Breaks are kept. out is cleared first, the temporary memory comes from scratch.
+SimplifyStats simplifySamples(const glm::vec2* samples, size_t count, const SampleView& view, double yMin,
+							  double yMax, const SimplifySettings& settings, Arena* scratch, SampleVector& out);
@@ -0,0 +1,54 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "curveSampler.hpp"
+
+// a curve that wants to be sampled this frame
+struct ScheduleCandidate {
+	size_t index = 0; // of the curve, for the caller
+	bool visible = true;
+	// how far the buffer drawn now is off on screen, infinite when it does not cover the view
+	float screenError = 0.0f;
+	float estimatedMs = 0.0f;
+};
+
+struct SchedulerStats {
+	size_t submittedJobs = 0;
+	float submittedMs = 0.0f; // estimated
+	size_t backlog = 0;		  // candidates left for the next frames
+	size_t finishedJobs = 0;
+	float finishedMs = 0.0f; // measured by the workers
+};
+
+// Splits sampling into passes from coarse to fine and decides each frame which curves are sampled.
+// Visible curves and the ones that are furthest off on screen go first, until the estimated cost of
+// the frame reaches the budget. A view change first shows a coarse result and refines it over the next frames.
+class SampleScheduler {
+  public:
+	// wall time per frame, the workers together get budgetMs times their count
+	float budgetMs = 4.0f;
+
+	// the pixel error of the first pass after a view change
+	float coarsePixelError = 4.0f;
+	// every following pass reduces the error by this factor until it reaches the final settings
+	float refineFactor = 3.0f;
+
+	// settings of the pass after one that reached currentError, currentError is infinite for the first pass
+	SamplerSettings nextPass(const SamplerSettings& final, float currentError) const;
+
+	// sorts candidates by priority and returns how many of the front ones fit into the budget of this frame,
+	// at least one so that a curve that is more expensive than the budget still gets sampled
+	size_t plan(ScheduleCandidate* candidates, size_t count, size_t threadCount);
+	// measured time of a finished job
+	void recordFinished(float milliseconds);
+
+	const SchedulerStats& getLastFrameStats() const {
+		return lastFrame;
+	}
+	// call once per frame after plan
+	void endFrame();
+
+  private:
+	SchedulerStats frame{};
+	SchedulerStats lastFrame{};
+};
@@ -0,0 +1,105 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "concurrentArena.hpp"
+#include "polylineSimplifier.hpp"
+#include "tileCache.hpp"
+
+// one curve to sample, cache belongs to the job until its result is collected
+struct SampleJob {
+	void* owner = nullptr; // handed back with the result
+	uint64_t generation = 0;
+	TileCache* cache = nullptr;
+	calcFunction func = nullptr;
+	const IntervalFunction* bounds = nullptr; // optional, read by the worker like func
+	ExpressionSymmetry symmetry{};
+	SampleView view{};
+	SamplerSettings settings{};
+	SimplifySettings simplify{};
+	uint64_t frame = 0;
+};
+
+struct SampleResult {
+	void* owner = nullptr;
+	uint64_t generation = 0; // of the job, the owner drops results of an older generation
+	SampleView view{};
+	TileCacheStats stats{};
+	SimplifyStats simplify{};
+	const glm::vec2* samples = nullptr; // valid inside of the collect callback, nullptr if memory ran out
+	size_t count = 0;
+	// the line strips between the breaks of samples
+	const int32_t* stripFirsts = nullptr;
+	const int32_t* stripCounts = nullptr;
+	size_t stripCount = 0;
+	float milliseconds = 0.0f; // time the worker spent on the job
+	size_t arenaSlot = 0;	   // the result arena of the pool holding samples and strips
+};
+
+// Samples curves on worker threads. Each worker samples and simplifies into private buffers and publishes finished
+// results, the render thread picks them up with collect once per frame and only uploads those.
+class SamplerPool {
+  public:
+	// 0 threads samples on the calling thread inside of submit
+	void init(size_t threadCount);
+	void shutdown();
+
+	void submit(const SampleJob& job);
+	// calls callback(SampleResult&) for every finished job on the calling thread
+	template <typename Callback> void collect(Callback callback);
+	// blocks until every submitted job has finished, for changes to the owners of the caches
+	void wait();
+
+	size_t getThreadCount() const {
+		return workers.size();
+	}
+
+  private:
+	struct QueuedJob {
+		SampleJob job;
+		size_t arenaSlot;
+	};
+
+	void workerMain();
+	void runJob(const SampleJob& job, size_t arenaSlot, Arena* scratch, SampleResult& result);
+	void takeResults(std::vector<SampleResult>& out);
+
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable jobAvailable;
+	std::condition_variable jobFinished;
+	std::vector<QueuedJob> jobs; // in the order they were submitted, workers take them from nextJob on
+	size_t nextJob = 0;
+	std::vector<SampleResult> results;
+	std::vector<SampleResult> collecting; // only touched by collect
+	size_t unfinishedJobs = 0;
+	bool stopping = false;
+
+	// the published samples, double buffered: new jobs publish into resultArenas[currentArena] while the results of
+	// the other one are still being collected. Once every result of the other one is collected it is reset and
+	// takes the new jobs, so the arenas are reset while panning and not only when the pool runs dry
+	ConcurrentArena resultArenas[2]{};
+	size_t currentArena = 0;
+	size_t pendingResults[2] = {}; // submitted into each arena and not collected yet
+	Arena inlineScratch{};
+};
+
+template <typename Callback> void SamplerPool::collect(Callback callback) {
+	takeResults(collecting);
+	for (SampleResult& result : collecting) {
+		callback(result);
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	for (const SampleResult& result : collecting) {
+		pendingResults[result.arenaSlot]--;
+	}
+	collecting.clear();
+	const size_t older = 1 - currentArena;
+	if (pendingResults[older] == 0) {
+		concurrent_arena_reset(&resultArenas[older]);
+		currentArena = older;
+	}
+}
@@ -0,0 +1,97 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include "curveSampler.hpp"
+#include "expressionSymmetry.hpp"
+
+class ChebyshevProxy;
+
+// tile index of a zoom level, the tile covers [index, index + 1) * 2^level world units
+struct TileKey {
+	int32_t level = 0;
+	int64_t index = 0;
+
+	bool operator==(const TileKey& other) const {
+		return level == other.level && index == other.index;
+	}
+};
+
+struct CurveTile {
+	TileKey key{};
+	glm::dvec2 anchor = {0.0, 0.0}; // samples are relative to it
+	// the samples are only refined inside of this band, a view reaching outside of it samples the tile again
+	double yMin = 0.0;
+	double yMax = 0.0;
+	float pixelError = 0.0f; // maxPixelError of the settings it was sampled with
+	bool envelope = false;	 // min/max columns of an oscillating curve
+	uint64_t lastUsed = 0;
+	uint32_t count = 0;
+	glm::vec2* samples = nullptr; // TILE_MAX_SAMPLES
+	// fitted the first time the tile of an expensive curve is sampled and used by every sampling after that,
+	// allocated on first use and kept for the next key like samples
+	ChebyshevProxy* proxy = nullptr;
+	bool proxyFitted = false;
+};
+
+struct TileCacheStats {
+	size_t hits = 0;
+	size_t misses = 0;
+	size_t evictions = 0;
+	size_t evaluations = 0;
+	size_t intervalEvaluations = 0;
+	size_t proxyEvaluations = 0;
+	// every gathered tile is refined for this band, outside of it the samples may be coarse
+	double yMin = -INFINITY;
+	double yMax = INFINITY;
+	float pixelError = 0.0f;   // the largest of the gathered tiles
+	size_t visibleSamples = 0; // inside of the y range of the view
+	size_t breaks = 0;
+	size_t envelopeTiles = 0;
+};
+
+// Samples of one curve in world space tiles at power of two zoom levels, like the tiles of a map.
+// Drawing a view only samples the tiles that are not cached yet, so panning costs the newly exposed tiles.
+// The tiles live in arena and are reused in least recently used order once the budget is used up.
+class TileCache {
+  public:
+	// a tile is between TILE_PIXELS / 2 and TILE_PIXELS wide on screen
+	static constexpr int TILE_PIXELS = 256;
+	static constexpr size_t TILE_MAX_SAMPLES = 1024;
+	static constexpr size_t DEFAULT_BUDGET_BYTES = 4 * 1024 * 1024;
+
+	explicit TileCache(Arena* arena, size_t budgetBytes = DEFAULT_BUDGET_BYTES);
+
+	// forgets every tile, for a new function or a new aspect ratio
+	void clear();
+	// appends the samples of [view.xMin, view.xMax] to out in the output frame of view, frame is for the LRU,
+	// tiles sampled with a larger error than settings are sampled again, new tiles are sampled in scratch. Not thread safe, but different caches can gather on different threads.
+	// With a parity the tiles left of x = 0 are mirrored from the ones right of it, with a period a tile
+	// holding many periods samples one and repeats it.
+	TileCacheStats gather(calcFunction func, const IntervalFunction* bounds, const ExpressionSymmetry& symmetry,
+						  const SampleView& view, const SamplerSettings& settings, uint64_t frame, Arena* scratch,
+						  SampleVector& out);
+
+	size_t getTileCount() const {
+		return tileCount;
+	}
+
+  private:
+	CurveTile* find(TileKey key);
+	// a tile for key, a new one while the budget lasts and the least recently used one after that
+	CurveTile* acquire(TileKey key, TileCacheStats& stats);
+	// caches the tile of key, it is sampled again unless the cached one is good enough for view
+	void ensureTile(TileKey key, calcFunction func, const IntervalFunction* bounds, const ExpressionSymmetry& symmetry,
+					const SampleView& view, const SamplerSettings& settings, uint64_t frame, Arena* scratch,
+					TileCacheStats& stats);
+	void sampleTile(CurveTile& tile, calcFunction func, const IntervalFunction* bounds,
+					const ExpressionSymmetry& symmetry, const SampleView& view, const SamplerSettings& settings,
+					Arena* scratch, TileCacheStats& stats);
+	// copies the mirror image of the cached tile of -x into tile, false if there is none good enough for view
+	bool mirrorTile(CurveTile& tile, Parity parity, const SampleView& view, const SamplerSettings& settings);
+
+	Arena* arena = nullptr;
+	CurveTile* tiles = nullptr;
+	size_t tileCount = 0;
+	size_t allocatedTiles = 0; // tiles with sample memory, clear keeps it
+	size_t maxTiles = 0;
+};
@@ -0,0 +1,230 @@
+#include "allocationCounter.hpp"
+
+#if COUNT_ALLOCATIONS
+#include "defines.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <imgui.h>
+#include <new>
+
+#if PLATFORM_WIN
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <execinfo.h>
+#include <unistd.h>
+#endif
+
+// nothing in here may allocate, the tables are fixed size and the stacks are hashed by their addresses
+static constexpr int stackDepth = 12;
+static constexpr size_t callSiteSlots = 4096;
+
+struct CallSite {
+	void* stack[stackDepth];
+	int depth;
+	size_t hash;
+	size_t allocations;
+	size_t bytes;
+};
+
+static CallSite callSites[callSiteSlots];
+static size_t droppedCallSites = 0;
+static std::atomic_flag callSitesLock = ATOMIC_FLAG_INIT;
+
+static std::atomic<size_t> frameAllocations{0};
+static std::atomic<size_t> frameBytes{0};
+
+// set while counting or reporting, so that allocations made by the backtrace functions are not counted
+static thread_local bool insideCounter = false;
+
+static int captureStack(void** stack) {
+#if PLATFORM_WIN
+	return CaptureStackBackTrace(2, stackDepth, stack, nullptr);
+#else
+	return backtrace(stack, stackDepth);
+#endif
+}
+
+static void countAllocation(size_t size) {
+	if (insideCounter) {
+		return;
+	}
+	insideCounter = true;
+	frameAllocations.fetch_add(1, std::memory_order_relaxed);
+	frameBytes.fetch_add(size, std::memory_order_relaxed);
+
+	void* stack[stackDepth];
+	int depth = captureStack(stack);
+	size_t hash = 14695981039346656037ull;
+	for (int i = 0; i < depth; i++) {
+		hash = (hash ^ reinterpret_cast<size_t>(stack[i])) * 1099511628211ull;
+	}
+
+	while (callSitesLock.test_and_set(std::memory_order_acquire)) {
+	}
+	size_t slot = hash % callSiteSlots;
+	for (size_t probe = 0; probe < callSiteSlots; probe++, slot = (slot + 1) % callSiteSlots) {
+		CallSite& site = callSites[slot];
+		if (site.allocations == 0) {
+			std::copy(stack, stack + depth, site.stack);
+			site.depth = depth;
+			site.hash = hash;
+		} else if (site.hash != hash) {
+			continue;
+		}
+		site.allocations++;
+		site.bytes += size;
+		break;
+	}
+	if (callSites[slot].hash != hash) {
+		droppedCallSites++;
+	}
+	callSitesLock.clear(std::memory_order_release);
+	insideCounter = false;
+}
+
+static void* countedAlloc(size_t size) {
+	countAllocation(size);
+	void* ptr = std::malloc(size == 0 ? 1 : size);
+	if (ptr == nullptr) {
+		throw std::bad_alloc();
+	}
+	return ptr;
+}
+
+static void* countedAlignedAlloc(size_t size, std::align_val_t align) {
+	countAllocation(size);
+	size_t alignment = static_cast<size_t>(align);
+#if PLATFORM_WIN
+	void* ptr = _aligned_malloc(size == 0 ? 1 : size, alignment);
+#else
+	void* ptr = std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+#endif
+	if (ptr == nullptr) {
+		throw std::bad_alloc();
+	}
+	return ptr;
+}
+
+static void countedAlignedFree(void* ptr) {
+#if PLATFORM_WIN
+	_aligned_free(ptr);
+#else
+	std::free(ptr);
+#endif
+}
+
+void* operator new(size_t size) {
+	return countedAlloc(size);
+}
+void* operator new[](size_t size) {
+	return countedAlloc(size);
+}
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+	try {
+		return countedAlloc(size);
+	} catch (...) {
+		return nullptr;
+	}
+}
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+	try {
+		return countedAlloc(size);
+	} catch (...) {
+		return nullptr;
+	}
+}
+void* operator new(size_t size, std::align_val_t align) {
+	return countedAlignedAlloc(size, align);
+}
+void* operator new[](size_t size, std::align_val_t align) {
+	return countedAlignedAlloc(size, align);
+}
+
+void operator delete(void* ptr) noexcept {
+	std::free(ptr);
+}
+void operator delete[](void* ptr) noexcept {
+	std::free(ptr);
+}
+void operator delete(void* ptr, size_t) noexcept {
+	std::free(ptr);
+}
+void operator delete[](void* ptr, size_t) noexcept {
+	std::free(ptr);
+}
+void operator delete(void* ptr, std::align_val_t) noexcept {
+	countedAlignedFree(ptr);
+}
+void operator delete[](void* ptr, std::align_val_t) noexcept {
+	countedAlignedFree(ptr);
+}
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept {
+	countedAlignedFree(ptr);
+}
+void operator delete[](void* ptr, size_t, std::align_val_t) noexcept {
+	countedAlignedFree(ptr);
+}
+
+static void* imguiAlloc(size_t size, void* userData) {
+	countAllocation(size);
+	return std::malloc(size);
+}
+
+static void imguiFree(void* ptr, void* userData) {
+	std::free(ptr);
+}
+
+void allocationCounterInstallImGuiHooks() {
+	ImGui::SetAllocatorFunctions(imguiAlloc, imguiFree);
+}
+
+AllocationCount allocationCounterEndFrame() {
+	AllocationCount count;
+	count.allocations = frameAllocations.exchange(0, std::memory_order_relaxed);
+	count.bytes = frameBytes.exchange(0, std::memory_order_relaxed);
+	return count;
+}
+
+void allocationCounterReport(FILE* out) {
+	insideCounter = true;
+	while (callSitesLock.test_and_set(std::memory_order_acquire)) {
+	}
+
+	// sort a list of slot indices, the table itself stays hashed
+	static size_t order[callSiteSlots];
+	size_t count = 0;
+	for (size_t i = 0; i < callSiteSlots; i++) {
+		if (callSites[i].allocations != 0) {
+			order[count++] = i;
+		}
+	}
+	std::sort(order, order + count,
+			  [](size_t a, size_t b) { return callSites[a].allocations > callSites[b].allocations; });
+
+	fprintf(out, "%zu call sites allocated since the last report, %zu not recorded\n", count, droppedCallSites);
+	for (size_t i = 0; i < count; i++) {
+		const CallSite& site = callSites[order[i]];
+		fprintf(out, "%zu allocations, %zu bytes:\n", site.allocations, site.bytes);
+		fflush(out);
+#if PLATFORM_WIN
+		for (int frame = 0; frame < site.depth; frame++) {
+			fprintf(out, "    %p\n", site.stack[frame]);
+		}
+#else
+		// the first frames are captureStack and countAllocation
+		const int skipped = std::min(site.depth, 2);
+		backtrace_symbols_fd(site.stack + skipped, site.depth - skipped, fileno(out));
+#endif
+	}
+	fflush(out);
+
+	std::fill(callSites, callSites + callSiteSlots, CallSite{});
+	droppedCallSites = 0;
+	callSitesLock.clear(std::memory_order_release);
+	insideCounter = false;
+}
+
+#endif
@@ -1,12 +1,30 @@
 #include "arena.hpp"
 #include "defines.hpp"
+#if ARENA_STATS
+#include <stdio.h>
+#endif
+
+static inline size_t region_bytes(size_t words) {
+	return offsetof(Region, data) + sizeof(uintptr_t) * words;
+}
+
+// bytes from the start of the region that have to be committed to hold words, rounded up to whole commit steps
+static inline size_t region_commit_bytes(size_t words, size_t capacity) {
+	size_t bytes = region_bytes(words);
+	bytes = (bytes + ARENA_COMMIT_GRANULARITY - 1) / ARENA_COMMIT_GRANULARITY * ARENA_COMMIT_GRANULARITY;
+	size_t reserved = region_bytes(capacity);
+	return bytes < reserved ? bytes : reserved;
+}
 
 #if ARENA_BACKEND == ARENA_BACKEND_LIBC_MALLOC
 #include <stdlib.h>
 
 // TODO: instead of accepting specific capacity new_region() should accept the size of the object we want to fit into the region
 // It should be up to new_region() to decide the actual capacity to allocate
-Region* new_region(size_t capacity) {
+Region* new_region(size_t capacity, size_t reserve_words) {
+	// there is nothing to commit later, the reservation is allocated right away
+	if (capacity < reserve_words)
+		capacity = reserve_words;
 	size_t size_bytes = sizeof(Region) + sizeof(uintptr_t) * capacity;
 	// TODO: it would be nice if we could guarantee that the regions are allocated by ARENA_BACKEND_LIBC_MALLOC are page aligned
 	Region* r = (Region*)malloc(size_bytes);
@@ -14,11 +32,30 @@ Region* new_region(size_t capacity) {
 	r->next = NULL;
 	r->count = 0;
 	r->capacity = capacity;
+	r->committed = capacity;
 
 	memset(r->data, 0, capacity);
 	return r;
 }
 
+static void region_commit(Region* r, size_t words) {
+	(void)r;
+	(void)words;
+	ARENA_ASSERT(0 && "malloc regions are committed completely");
+}
+
+static void region_decommit(Region* r, size_t words) {
+	// a malloc region can only be given back as a whole
+	(void)r;
+	(void)words;
+}
+
+void region_commit_range(Region* r, size_t first_word, size_t words) {
+	(void)r;
+	(void)first_word;
+	(void)words;
+}
+
 void free_region(Region* r) {
 	free(r);
 }
@@ -27,20 +64,66 @@ void free_region(Region* r) {
 #include <unistd.h>
 #include <sys/mman.h>
 
-Region* new_region(size_t capacity) {
-	size_t size_bytes = sizeof(Region) + sizeof(uintptr_t) * capacity;
-	Region* r = (Region*)mmap(NULL, size_bytes, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+// The whole capacity is reserved up front without backing it, the pages are made accessible
+// by region_commit as the bump pointer reaches them. Fresh pages are zero, so nothing is memset.
+Region* new_region(size_t capacity, size_t reserve_words) {
+	if (reserve_words == 0)
+		reserve_words = ARENA_RESERVE_WORDS;
+	size_t reserved_words = capacity < reserve_words ? reserve_words : capacity;
+	size_t size_bytes = region_bytes(reserved_words);
+	Region* r = (Region*)mmap(NULL, size_bytes, PROT_NONE, MAP_ANONYMOUS | MAP_PRIVATE | MAP_NORESERVE, -1, 0);
 	ARENA_ASSERT(r != MAP_FAILED);
+#if ARENA_USE_HUGE_PAGES
+	madvise(r, size_bytes, MADV_HUGEPAGE);
+#endif
+	size_t committed_bytes = region_commit_bytes(capacity, reserved_words);
+	int ret = mprotect(r, committed_bytes, PROT_READ | PROT_WRITE);
+	(void)ret;
+	ARENA_ASSERT(ret == 0);
+
 	r->next = NULL;
 	r->count = 0;
-	r->capacity = capacity;
-
-	memset(r->data, 0, capacity);
+	r->capacity = reserved_words;
+	r->committed = (committed_bytes - offsetof(Region, data)) / sizeof(uintptr_t);
 	return r;
 }
 
+static void region_commit(Region* r, size_t words) {
+	// grow geometrically so a growing vector does not commit page by page
+	size_t target = r->committed * 2;
+	if (target < words)
+		target = words;
+	size_t old_bytes = region_bytes(r->committed);
+	size_t new_bytes = region_commit_bytes(target, r->capacity);
+	int ret = mprotect((char*)r + old_bytes, new_bytes - old_bytes, PROT_READ | PROT_WRITE);
+	(void)ret;
+	ARENA_ASSERT(ret == 0);
+	r->committed = (new_bytes - offsetof(Region, data)) / sizeof(uintptr_t);
+}
+
+static void region_decommit(Region* r, size_t words) {
+	size_t keep_bytes = region_commit_bytes(words, r->capacity);
+	size_t old_bytes = region_bytes(r->committed);
+	if (keep_bytes >= old_bytes)
+		return;
+	// MADV_DONTNEED drops the pages right away, they come back zeroed when committed again
+	int ret = madvise((char*)r + keep_bytes, old_bytes - keep_bytes, MADV_DONTNEED);
+	ret |= mprotect((char*)r + keep_bytes, old_bytes - keep_bytes, PROT_NONE);
+	(void)ret;
+	ARENA_ASSERT(ret == 0);
+	r->committed = (keep_bytes - offsetof(Region, data)) / sizeof(uintptr_t);
+}
+
+void region_commit_range(Region* r, size_t first_word, size_t words) {
+	size_t first = region_bytes(first_word) / ARENA_COMMIT_GRANULARITY * ARENA_COMMIT_GRANULARITY;
+	size_t last = region_commit_bytes(first_word + words, r->capacity);
+	int ret = mprotect((char*)r + first, last - first, PROT_READ | PROT_WRITE);
+	(void)ret;
+	ARENA_ASSERT(ret == 0);
+}
+
 void free_region(Region* r) {
-	size_t size_bytes = sizeof(Region) + sizeof(uintptr_t) * r->capacity;
+	size_t size_bytes = region_bytes(r->capacity);
 	int ret = munmap(r, size_bytes);
 	(void)ret;
 	ARENA_ASSERT(ret == 0);
@@ -58,24 +141,65 @@ void free_region(Region* r) {
 
 #define INV_HANDLE(x) (((x) == NULL) || ((x) == INVALID_HANDLE_VALUE))
 
-Region* new_region(size_t capacity) {
-	SIZE_T size_bytes = sizeof(Region) + sizeof(uintptr_t) * capacity;
-	Region* r = (Region*)VirtualAllocEx(GetCurrentProcess(),	  /* Allocate in current process address space */
-										NULL,					  /* Unknown position */
-										size_bytes,				  /* Bytes to allocate */
-										MEM_COMMIT | MEM_RESERVE, /* Reserve and commit allocated page */
-										PAGE_READWRITE			  /* Permissions ( Read/Write )*/
+// same scheme as the mmap backend, large pages need a privilege on Windows so they are not used here
+Region* new_region(size_t capacity, size_t reserve_words) {
+	if (reserve_words == 0)
+		reserve_words = ARENA_RESERVE_WORDS;
+	size_t reserved_words = capacity < reserve_words ? reserve_words : capacity;
+	SIZE_T size_bytes = region_bytes(reserved_words);
+	Region* r = (Region*)VirtualAllocEx(GetCurrentProcess(), /* Allocate in current process address space */
+										NULL,				 /* Unknown position */
+										size_bytes,			 /* Bytes to reserve */
+										MEM_RESERVE,		 /* Only reserve, pages are committed on demand */
+										PAGE_NOACCESS		 /* Permissions ( None until committed )*/
 	);
 	if (INV_HANDLE(r)) {
 		ARENA_ASSERT(0 && "VirtualAllocEx() failed.");
 	}
+	SIZE_T committed_bytes = region_commit_bytes(capacity, reserved_words);
+	if (VirtualAllocEx(GetCurrentProcess(), r, committed_bytes, MEM_COMMIT, PAGE_READWRITE) == NULL) {
+		ARENA_ASSERT(0 && "VirtualAllocEx() commit failed.");
+	}
+
 	r->next = NULL;
 	r->count = 0;
-	r->capacity = capacity;
-	memset(r->data, 0, capacity);
+	r->capacity = reserved_words;
+	r->committed = (committed_bytes - offsetof(Region, data)) / sizeof(uintptr_t);
 	return r;
 }
 
+static void region_commit(Region* r, size_t words) {
+	size_t target = r->committed * 2;
+	if (target < words)
+		target = words;
+	size_t old_bytes = region_bytes(r->committed);
+	size_t new_bytes = region_commit_bytes(target, r->capacity);
+	if (VirtualAllocEx(GetCurrentProcess(), (char*)r + old_bytes, new_bytes - old_bytes, MEM_COMMIT, PAGE_READWRITE) ==
+		NULL) {
+		ARENA_ASSERT(0 && "VirtualAllocEx() commit failed.");
+	}
+	r->committed = (new_bytes - offsetof(Region, data)) / sizeof(uintptr_t);
+}
+
+static void region_decommit(Region* r, size_t words) {
+	size_t keep_bytes = region_commit_bytes(words, r->capacity);
+	size_t old_bytes = region_bytes(r->committed);
+	if (keep_bytes >= old_bytes)
+		return;
+	if (FALSE == VirtualFreeEx(GetCurrentProcess(), (char*)r + keep_bytes, old_bytes - keep_bytes, MEM_DECOMMIT)) {
+		ARENA_ASSERT(0 && "VirtualFreeEx() decommit failed.");
+	}
+	r->committed = (keep_bytes - offsetof(Region, data)) / sizeof(uintptr_t);
+}
+
+void region_commit_range(Region* r, size_t first_word, size_t words) {
+	size_t first = region_bytes(first_word) / ARENA_COMMIT_GRANULARITY * ARENA_COMMIT_GRANULARITY;
+	size_t last = region_commit_bytes(first_word + words, r->capacity);
+	if (VirtualAllocEx(GetCurrentProcess(), (char*)r + first, last - first, MEM_COMMIT, PAGE_READWRITE) == NULL) {
+		ARENA_ASSERT(0 && "VirtualAllocEx() commit failed.");
+	}
+}
+
 void free_region(Region* r) {
 	if (INV_HANDLE(r))
 		return;
@@ -96,45 +220,128 @@ void free_region(Region* r) {
 #error "Unknown Arena backend"
 #endif
 
-// TODO: add debug statistic collection mode for arena
-// Should collect things like:
-// - How many times new_region was called
-// - How many times existing region was skipped
-// - How many times allocation exceeded REGION_DEFAULT_CAPACITY
+static inline size_t arena_words(size_t size_bytes) {
+	return (size_bytes + sizeof(uintptr_t) - 1) / sizeof(uintptr_t);
+}
+
+// whether [ptr, ptr + words) is the last allocation in the current region
+static inline bool arena_is_last(const Arena* a, const void* ptr, size_t words) {
+	const Region* r = a->end;
+	return r != NULL && ptr != NULL && (const uintptr_t*)ptr + words == &r->data[r->count];
+}
+
+static size_t arena_used_bytes(const Arena* a) {
+	size_t used = 0;
+	for (const Region* r = a->begin; r != NULL; r = r->next) {
+		used += r->count;
+	}
+	return used * sizeof(uintptr_t);
+}
+
+#if ARENA_STATS
+// words added to the current tag, without counting an allocation, for blocks that grow in place
+static inline void arena_stats_count_words(Arena* a, size_t size) {
+	ArenaStats* stats = &a->stats;
+	ArenaTagStats* tag = &stats->tags[stats->current_tag];
+	stats->frame_bytes += size * sizeof(uintptr_t);
+	tag->frame_bytes += size * sizeof(uintptr_t);
+	tag->total_bytes += size * sizeof(uintptr_t);
+}
+
+static inline void arena_stats_count(Arena* a, size_t size) {
+	arena_stats_count_words(a, size);
+	a->stats.tags[a->stats.current_tag].allocations++;
+	if (size > REGION_DEFAULT_CAPACITY)
+		a->stats.oversize_allocs++;
+}
+#endif
 
 void* arena_alloc(Arena* a, size_t size_bytes) {
-	size_t size = (size_bytes + sizeof(uintptr_t) - 1) / sizeof(uintptr_t);
+	size_t size = arena_words(size_bytes);
 	ARENA_ASSERT(a != NULL);
 	ARENA_ASSERT(a->begin != NULL);
 	ARENA_ASSERT(a->end != NULL);
 
-	while (a->end->count + size > a->end->capacity && a->end->next != NULL) {
-		a->end = a->end->next;
+#if ARENA_STATS
+	arena_stats_count(a, size);
+#endif
+
+	Region* r = a->end;
+	if (r->count + size > r->committed) {
+		// regions after end are only left over from before an arena_reset
+		while (r->count + size > r->capacity && r->next != NULL) {
+			r = r->next;
+#if ARENA_STATS
+			a->stats.skipped_regions++;
+#endif
+		}
+
+		if (r->count + size > r->capacity) {
+			ARENA_ASSERT(r->next == NULL);
+			// every new region is at least twice as large, so chains stay short
+			size_t capacity = r->capacity * 2;
+			if (capacity < size)
+				capacity = size;
+			r->next = new_region(capacity);
+			r = r->next;
+#if ARENA_STATS
+			a->stats.new_regions++;
+#endif
+		}
+
+		if (r->count + size > r->committed) {
+			region_commit(r, r->count + size);
+		}
+		a->end = r;
 	}
 
-	if (a->end->count + size > a->end->capacity) {
-		ARENA_ASSERT(a->end->next == NULL);
-		size_t capacity = REGION_DEFAULT_CAPACITY;
-		if (capacity < size)
-			capacity = size;
-		a->end->next = new_region(capacity);
-		a->end = a->end->next;
+	void* result = &r->data[r->count];
+	r->count += size;
+	return result;
+}
+
+void* arena_alloc_aligned(Arena* a, size_t size_bytes, size_t align) {
+	ARENA_ASSERT((align & (align - 1)) == 0);
+	if (align <= sizeof(uintptr_t))
+		return arena_alloc(a, size_bytes);
+
+	// words to skip in the current region to reach the alignment
+	uintptr_t address = (uintptr_t)&a->end->data[a->end->count];
+	size_t padding = (((address + align - 1) & ~(uintptr_t)(align - 1)) - address) / sizeof(uintptr_t);
+	if (a->end->count + padding + arena_words(size_bytes) <= a->end->committed) {
+		a->end->count += padding;
+		return arena_alloc(a, size_bytes);
 	}
 
-	void* result = &a->end->data[a->end->count];
-	a->end->count += size;
+	// the allocation may end up in another region, so take enough for any padding and give the rest back
+	uintptr_t* block = (uintptr_t*)arena_alloc(a, size_bytes + align - sizeof(uintptr_t));
+	uintptr_t* result = (uintptr_t*)(((uintptr_t)block + align - 1) & ~(uintptr_t)(align - 1));
+	a->end->count = (size_t)(result - a->end->data) + arena_words(size_bytes);
 	return result;
 }
 
 void* arena_realloc(Arena* a, void* oldptr, size_t oldsz, size_t newsz) {
 	if (newsz <= oldsz)
 		return oldptr;
+
+	const size_t old_words = arena_words(oldsz);
+	const size_t new_words = arena_words(newsz);
+	if (arena_is_last(a, oldptr, old_words) && a->end->count - old_words + new_words <= a->end->capacity) {
+		if (a->end->count - old_words + new_words > a->end->committed) {
+			region_commit(a->end, a->end->count - old_words + new_words);
+		}
+		a->end->count += new_words - old_words;
+#if ARENA_STATS
+		arena_stats_count_words(a, new_words - old_words);
+#endif
+		return oldptr;
+	}
+
 	void* newptr = arena_alloc(a, newsz);
-	char* newptr_char = (char*)newptr;
-	char* oldptr_char = (char*)oldptr;
-	for (size_t i = 0; i < oldsz; ++i) {
-		newptr_char[i] = oldptr_char[i];
+	if (oldsz != 0) {
+		memcpy(newptr, oldptr, oldsz);
 	}
+	a->realloc_wasted_bytes += old_words * sizeof(uintptr_t);
 	return newptr;
 }
 
@@ -181,6 +388,19 @@ Arena arena_init(size_t reservedCapacity) {
 }
 
 void arena_reset(Arena* a) {
+#if ARENA_STATS
+	ArenaStats* stats = &a->stats;
+	size_t used = arena_used_bytes(a);
+	if (used > stats->peak_used_bytes)
+		stats->peak_used_bytes = used;
+	stats->last_frame_bytes = stats->frame_bytes;
+	stats->frame_bytes = 0;
+	for (size_t i = 0; i <= stats->tag_count; i++) {
+		stats->tags[i].last_frame_bytes = stats->tags[i].frame_bytes;
+		stats->tags[i].frame_bytes = 0;
+	}
+#endif
+
 	for (Region* r = a->begin; r != NULL; r = r->next) {
 		r->count = 0;
 	}
@@ -188,6 +408,84 @@ void arena_reset(Arena* a) {
 	a->end = a->begin;
 }
 
+ArenaSnapshot arena_snapshot(Arena* a) {
+	ArenaSnapshot snapshot;
+	snapshot.end = a->end;
+	snapshot.count = a->end->count;
+	return snapshot;
+}
+
+void arena_rewind(Arena* a, ArenaSnapshot snapshot) {
+	// the trim policy has to see the peak, not what is left at the end of the frame
+	size_t used = arena_used_bytes(a);
+	if (used > a->peak_rewound_bytes)
+		a->peak_rewound_bytes = used;
+#if ARENA_STATS
+	if (used > a->stats.peak_used_bytes)
+		a->stats.peak_used_bytes = used;
+#endif
+
+	if (snapshot.end != a->end) {
+		for (Region* r = snapshot.end->next; r != a->end->next; r = r->next) {
+			r->count = 0;
+		}
+	}
+	ARENA_ASSERT(snapshot.count <= snapshot.end->count);
+	snapshot.end->count = snapshot.count;
+	a->end = snapshot.end;
+}
+
+void arena_reset_and_trim(Arena* a, const ArenaTrimPolicy* policy) {
+	size_t used = arena_used_bytes(a);
+	if (used < a->peak_rewound_bytes)
+		used = a->peak_rewound_bytes;
+	a->peak_rewound_bytes = 0;
+
+	size_t committed = 0;
+	for (Region* r = a->begin; r != NULL; r = r->next) {
+		committed += r->committed;
+	}
+	committed *= sizeof(uintptr_t);
+
+	size_t decayed = (size_t)(a->high_water_bytes * policy->decay);
+	a->high_water_bytes = used > decayed ? used : decayed;
+
+	if (committed > policy->min_keep_bytes && a->high_water_bytes < committed * policy->threshold) {
+		a->frames_below_threshold++;
+	} else {
+		a->frames_below_threshold = 0;
+	}
+
+	arena_reset(a);
+	if (a->frames_below_threshold >= policy->frames) {
+		size_t keep = a->high_water_bytes > policy->min_keep_bytes ? a->high_water_bytes : policy->min_keep_bytes;
+		arena_trim(a, keep);
+		a->frames_below_threshold = 0;
+	}
+}
+
+void arena_trim(Arena* a, size_t keep_bytes) {
+	ARENA_ASSERT(a->end == a->begin && a->begin->count == 0);
+	size_t keep = (keep_bytes + sizeof(uintptr_t) - 1) / sizeof(uintptr_t);
+
+	// the first region always stays, so the arena remains usable
+	Region* r = a->begin;
+	region_decommit(r, keep);
+	keep = keep > r->committed ? keep - r->committed : 0;
+
+	while (r->next != NULL) {
+		Region* next = r->next;
+		if (keep == 0) {
+			r->next = next->next;
+			free_region(next);
+		} else {
+			region_decommit(next, keep);
+			keep = keep > next->committed ? keep - next->committed : 0;
+			r = next;
+		}
+	}
+}
+
 void arena_free(Arena* a) {
 	Region* r = a->begin;
 	while (r) {
@@ -197,4 +495,74 @@ void arena_free(Arena* a) {
 	}
 	a->begin = NULL;
 	a->end = NULL;
-}
\ No newline at end of file
+}
+
+const char* arena_set_tag(Arena* a, const char* tag) {
+#if ARENA_STATS
+	ArenaStats* stats = &a->stats;
+	const char* previous = stats->tags[stats->current_tag].name;
+	size_t index = 0;
+	if (tag != NULL) {
+		// tag 0 stays for untagged allocations, and takes everything once the table is full
+		for (index = 1; index <= stats->tag_count; index++) {
+			if (strcmp(stats->tags[index].name, tag) == 0)
+				break;
+		}
+		if (index > stats->tag_count) {
+			if (stats->tag_count + 1 < ARENA_MAX_TAGS) {
+				stats->tag_count++;
+				stats->tags[index].name = tag;
+			} else {
+				index = 0;
+			}
+		}
+	}
+	stats->current_tag = index;
+	return previous;
+#else
+	(void)a;
+	(void)tag;
+	return NULL;
+#endif
+}
+
+int arena_stats_json(const Arena* a, const char* name, char* buffer, size_t buffer_size) {
+	size_t used = arena_used_bytes(a);
+	size_t committed = 0;
+	size_t regions = 0;
+	for (const Region* r = a->begin; r != NULL; r = r->next) {
+		committed += r->committed * sizeof(uintptr_t);
+		regions++;
+	}
+#if ARENA_STATS
+	const ArenaStats* stats = &a->stats;
+	int length = snprintf(buffer, buffer_size,
+						  "{\"name\":\"%s\",\"used\":%zu,\"committed\":%zu,\"regions\":%zu,\"new_regions\":%zu,"
+						  "\"skipped_regions\":%zu,\"oversize_allocs\":%zu,\"frame_bytes\":%zu,\"last_frame_bytes\":%zu,"
+						  "\"peak_used_bytes\":%zu,\"high_water_bytes\":%zu,\"realloc_wasted_bytes\":%zu,\"tags\":[",
+						  name, used, committed, regions, stats->new_regions, stats->skipped_regions, stats->oversize_allocs,
+						  stats->frame_bytes, stats->last_frame_bytes, stats->peak_used_bytes, a->high_water_bytes,
+						  a->realloc_wasted_bytes);
+	for (size_t i = 0; i <= stats->tag_count; i++) {
+		const ArenaTagStats* tag = &stats->tags[i];
+		size_t offset = length < 0 ? buffer_size : (size_t)length;
+		length += snprintf(offset < buffer_size ? buffer + offset : NULL, offset < buffer_size ? buffer_size - offset : 0,
+						   "%s{\"tag\":\"%s\",\"allocations\":%zu,\"frame_bytes\":%zu,\"last_frame_bytes\":%zu,"
+						   "\"total_bytes\":%zu}",
+						   i == 0 ? "" : ",", tag->name != NULL ? tag->name : "untagged", tag->allocations,
+						   tag->frame_bytes, tag->last_frame_bytes, tag->total_bytes);
+	}
+	size_t offset = (size_t)length;
+	length += snprintf(offset < buffer_size ? buffer + offset : NULL, offset < buffer_size ? buffer_size - offset : 0,
+					   "]}");
+	return length;
+#else
+	(void)name;
+	(void)used;
+	(void)committed;
+	(void)regions;
+	if (buffer_size > 0)
+		buffer[0] = '\0';
+	return 0;
+#endif
+}
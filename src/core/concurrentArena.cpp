@@ -0,0 +1,93 @@
+#include "concurrentArena.hpp"
+
+// chunks of the arenas the current thread allocated from last
+struct ThreadChunk {
+	const ConcurrentArena* arena;
+	uint64_t generation;
+	uintptr_t* cursor;
+	uintptr_t* limit;
+};
+
+static constexpr size_t threadChunkSlots = 4;
+static thread_local ThreadChunk threadChunks[threadChunkSlots] = {};
+static thread_local size_t nextThreadChunkSlot = 0;
+
+// generations are unique over all arenas, so a chunk can't be mistaken for one of a new arena at the same address
+static std::atomic<uint64_t> generationCounter{1};
+
+// makes the first words of the region accessible, only the thread that gets past committed first makes a syscall
+static void commit_words(ConcurrentArena* a, size_t words) {
+	if (words <= a->committed.load(std::memory_order_acquire)) {
+		return;
+	}
+	std::lock_guard<std::mutex> lock(a->commit_mutex);
+	size_t committed = a->committed.load(std::memory_order_relaxed);
+	if (words <= committed) {
+		return;
+	}
+	// grow geometrically like region_commit, so the slow path is taken a few times per arena
+	size_t target = committed * 2 > words ? committed * 2 : words;
+	if (target > a->region->capacity) {
+		target = a->region->capacity;
+	}
+	region_commit_range(a->region, committed, target - committed);
+	a->committed.store(target, std::memory_order_release);
+}
+
+void concurrent_arena_init(ConcurrentArena* a, size_t capacity, size_t chunk_words) {
+	ARENA_ASSERT(a->region == NULL);
+	a->region = new_region(chunk_words, capacity);
+	a->chunk_words = chunk_words;
+	a->used.store(0, std::memory_order_relaxed);
+	a->committed.store(a->region->committed, std::memory_order_release);
+	a->generation.store(generationCounter.fetch_add(1, std::memory_order_relaxed), std::memory_order_release);
+}
+
+void* concurrent_arena_alloc(ConcurrentArena* a, size_t size_bytes) {
+	size_t size = (size_bytes + sizeof(uintptr_t) - 1) / sizeof(uintptr_t);
+	uint64_t generation = a->generation.load(std::memory_order_acquire);
+
+	ThreadChunk* chunk = NULL;
+	for (ThreadChunk& slot : threadChunks) {
+		if (slot.arena == a) {
+			chunk = &slot;
+			break;
+		}
+	}
+	if (chunk != NULL && chunk->generation == generation && (size_t)(chunk->limit - chunk->cursor) >= size) {
+		void* result = chunk->cursor;
+		chunk->cursor += size;
+		return result;
+	}
+
+	// take a new chunk, allocations larger than a chunk get one of their own
+	if (chunk == NULL) {
+		chunk = &threadChunks[nextThreadChunkSlot++ % threadChunkSlots];
+	}
+	size_t words = size > a->chunk_words ? size : a->chunk_words;
+	size_t first = a->used.fetch_add(words, std::memory_order_relaxed);
+	if (first + words > a->region->capacity) {
+		return NULL;
+	}
+	commit_words(a, first + words);
+
+	chunk->arena = a;
+	chunk->generation = generation;
+	chunk->cursor = &a->region->data[first] + size;
+	chunk->limit = &a->region->data[first] + words;
+	return &a->region->data[first];
+}
+
+void concurrent_arena_reset(ConcurrentArena* a) {
+	a->used.store(0, std::memory_order_relaxed);
+	a->generation.store(generationCounter.fetch_add(1, std::memory_order_relaxed), std::memory_order_release);
+}
+
+void concurrent_arena_free(ConcurrentArena* a) {
+	if (a->region != NULL) {
+		free_region(a->region);
+		a->region = NULL;
+	}
+	a->committed.store(0, std::memory_order_relaxed);
+	a->generation.store(0, std::memory_order_release);
+}
@@ -11,6 +11,8 @@
 #include <llvm/Support/FileSystem.h> // For file writing support
 #include <llvm/Transforms/Scalar.h>
 #include <llvm/IR/BasicBlock.h>
+#include <llvm/IR/Intrinsics.h>
+#include <llvm/Transforms/Utils/ModuleUtils.h>
 #include <llvm/ExecutionEngine/JITLink/JITLinkMemoryManager.h>
 #include <llvm/ExecutionEngine/Orc/ObjectLinkingLayer.h>
 #include <llvm/TargetParser/Host.h>
@@ -25,7 +27,14 @@
 using namespace llvm;
 using namespace llvm::orc;
 
+static constexpr size_t jobArenaCapacity = 512;
+
 JITCompiler::JITCompiler() {
+	arena_init(&jobArena, jobArenaCapacity);
+}
+
+JITCompiler::~JITCompiler() {
+	arena_free(&jobArena);
 }
 
 CompiledFunction JITCompiler::compile(ExpressionNode* expr) {
@@ -81,6 +90,7 @@ ThreadSafeModule JITCompiler::createModule(ExpressionNode* expr) {
 	ArgX->setName("x");
 
 	variable = ArgX;
+	createdFunctions.fill(nullptr);
 	builderPtr = &builder;
 	contextPtr = context.get();
 	modulePtr = M;
@@ -128,7 +138,6 @@ llvm::Value* JITCompiler::generateCode(ExpressionNode* expr) {
 		return builderPtr->CreateFDiv(left, right, "divtmp");
 	}
 	case NodeType::Pow: {
-		createExternalFunction("pow");
 		llvm::Value* left = generateCode(expr->binary.left);
 		llvm::Value* right = generateCode(expr->binary.right);
 
@@ -153,24 +162,17 @@ llvm::Value* JITCompiler::generateCode(ExpressionNode* expr) {
 			llvm::Value* outerExponent = right; // Use the exponent from the current Pow
 			llvm::Value* newExponent = builderPtr->CreateFMul(innerExponent, outerExponent, "exponentProduct");
 
-			CallInst* callinst = builderPtr->CreateCall(createdFunctions.at("pow"), {innerBase, newExponent}, "powtmp");
-			callinst->setTailCall(true);
-			return callinst;
+			return createBuiltinCall(Builtin::Pow, {innerBase, newExponent});
 		}
-		CallInst* callinst = builderPtr->CreateCall(createdFunctions.at("pow"), {left, right}, "powtmp");
-		callinst->setTailCall(true);
-		return callinst;
+		return createBuiltinCall(Builtin::Pow, {left, right});
 
 	}
 	case NodeType::Variable: {
 		return variable; // Return the variable (the function's argument)
 	}
 	case NodeType::Function: {
-		createExternalFunction(expr->function.name);
 		llvm::Value* argValue = generateCode(expr->function.argument);
-		CallInst* callinst = builderPtr->CreateCall(createdFunctions.at(expr->function.name), {argValue}, "funccalltmp");
-		callinst->setTailCall(true);
-		return callinst;
+		return createBuiltinCall(expr->function.id, {argValue});
 	}
 	case NodeType::Error: {
 		assert(0 && "ERROR WAS FOUND!, YOU PROBABLY FORGOT TO CHECK FOR IT");
@@ -184,13 +186,82 @@ llvm::Value* JITCompiler::generateCode(ExpressionNode* expr) {
 	unreachable();
 }
 
-void JITCompiler::createExternalFunction(const std::string_view name) {
+static llvm::Intrinsic::ID getIntrinsicID(BuiltinIntrinsic intrinsic) {
+	switch (intrinsic) {
+	case BuiltinIntrinsic::Sin:
+		return llvm::Intrinsic::sin;
+	case BuiltinIntrinsic::Cos:
+		return llvm::Intrinsic::cos;
+	case BuiltinIntrinsic::Log:
+		return llvm::Intrinsic::log;
+	case BuiltinIntrinsic::Log10:
+		return llvm::Intrinsic::log10;
+	case BuiltinIntrinsic::Sqrt:
+		return llvm::Intrinsic::sqrt;
+	case BuiltinIntrinsic::Ceil:
+		return llvm::Intrinsic::ceil;
+	case BuiltinIntrinsic::Fabs:
+		return llvm::Intrinsic::fabs;
+	case BuiltinIntrinsic::Floor:
+		return llvm::Intrinsic::floor;
+	case BuiltinIntrinsic::Round:
+		return llvm::Intrinsic::round;
+	case BuiltinIntrinsic::Pow:
+		return llvm::Intrinsic::pow;
+	case BuiltinIntrinsic::None:
+		break;
+	}
+	return llvm::Intrinsic::not_intrinsic;
+}
+
+llvm::Function* JITCompiler::getBuiltinFunction(Builtin builtin) {
 	// Check if the function has already been created
-	if (createdFunctions.find(name) == createdFunctions.end()) {
-		llvm::Function* func = llvm::Function::Create(funcType, llvm::Function::ExternalLinkage, name, modulePtr);
-		func->addFnAttr(llvm::Attribute::ReadNone);
-		func->addFnAttr(llvm::Attribute::NoUnwind);
-		func->addFnAttr(llvm::Attribute::AlwaysInline);
-		createdFunctions[name] = func; // Mark this function as created
-	}
-}
\ No newline at end of file
+	llvm::Function*& func = createdFunctions[static_cast<size_t>(builtin)];
+	if (func != nullptr) {
+		return func;
+	}
+
+	const BuiltinInfo& info = getBuiltinInfo(builtin);
+	assert(info.kind == BuiltinKind::Function);
+	llvm::Type* doubleType = llvm::Type::getDoubleTy(*contextPtr);
+
+	if (info.intrinsic != BuiltinIntrinsic::None) {
+		func = llvm::Intrinsic::getDeclaration(modulePtr, getIntrinsicID(info.intrinsic), {doubleType});
+		return func;
+	}
+
+	std::vector<llvm::Type*, ArenaAllocator<llvm::Type*>> params(info.arity, doubleType,
+																 ArenaAllocator<llvm::Type*>(&jobArena));
+	llvm::FunctionType* type = llvm::FunctionType::get(doubleType, params, false);
+	func = llvm::Function::Create(type, llvm::Function::ExternalLinkage, llvm::StringRef(info.name.data(), info.name.size()),
+								  modulePtr);
+	if (info.isPure) {
+		func->setDoesNotAccessMemory();
+	}
+	func->addFnAttr(llvm::Attribute::NoUnwind);
+	func->addFnAttr(llvm::Attribute::AlwaysInline);
+	return func;
+}
+
+llvm::CallInst* JITCompiler::createBuiltinCall(Builtin builtin, llvm::ArrayRef<llvm::Value*> args) {
+	const BuiltinInfo& info = getBuiltinInfo(builtin);
+	assert(args.size() == info.arity);
+
+	llvm::Function* func = getBuiltinFunction(builtin);
+	CallInst* callinst = builderPtr->CreateCall(func, args, "funccalltmp");
+	callinst->setTailCall(true);
+
+	// let the loop vectorizer know about the vector math library variant
+	if (!info.vectorVariant.empty()) {
+		const std::string variantName(info.vectorVariant);
+		llvm::Type* vectorType = llvm::FixedVectorType::get(llvm::Type::getDoubleTy(*contextPtr), 4);
+		std::vector<llvm::Type*, ArenaAllocator<llvm::Type*>> params(info.arity, vectorType,
+																	 ArenaAllocator<llvm::Type*>(&jobArena));
+		modulePtr->getOrInsertFunction(variantName, llvm::FunctionType::get(vectorType, params, false));
+
+		const std::string mangledName = "_ZGV_LLVM_N4" + std::string(info.arity, 'v') + "_" + func->getName().str() +
+										"(" + variantName + ")";
+		llvm::VFABI::setVectorVariantNames(callinst, {mangledName});
+	}
+	return callinst;
+}
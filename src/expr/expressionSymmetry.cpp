@@ -0,0 +1,230 @@
+#include "expressionSymmetry.hpp"
+#include "parser.hpp"
+#include <cmath>
+
+#pragma region helperFunction
+
+static constexpr double pi = 3.14159265358979323846;
+// periods P and Q are combined if m P == n Q for m, n up to this
+static constexpr int maxPeriodMultiple = 16;
+
+// what is known about one subtree
+struct NodeShape {
+	bool constant = false; // does not depend on x, periodic with every period
+	bool known = false;	   // constant with a value from numbers alone
+	double value = 0.0;
+	// slope * x + something, only for slope != 0 or constant
+	bool affine = false;
+	double slope = 0.0;
+	double period = 0.0;
+	Parity parity = Parity::None;
+};
+
+static NodeShape constantShape(bool known, double value) {
+	NodeShape shape;
+	shape.constant = true;
+	shape.known = known;
+	shape.value = value;
+	shape.affine = true;
+	shape.parity = Parity::Even;
+	return shape;
+}
+
+// the smallest common period of a and b, 0 if there is none with small multiples
+static double commonPeriod(double a, double b) {
+	for (int m = 1; m <= maxPeriodMultiple; m++) {
+		for (int n = 1; n <= maxPeriodMultiple; n++) {
+			if (std::abs(m * a - n * b) <= 1e-12 * m * a) {
+				return m * a;
+			}
+		}
+	}
+	return 0.0;
+}
+
+// period of a combination of a and b, a constant takes the period of the other side
+static double combinePeriods(const NodeShape& a, const NodeShape& b) {
+	if (a.constant) {
+		return b.period;
+	}
+	if (b.constant) {
+		return a.period;
+	}
+	if (a.period == 0.0 || b.period == 0.0) {
+		return 0.0;
+	}
+	return commonPeriod(a.period, b.period);
+}
+
+static Parity multiplyParity(Parity a, Parity b) {
+	if (a == Parity::None || b == Parity::None) {
+		return Parity::None;
+	}
+	return a == b ? Parity::Even : Parity::Odd;
+}
+
+static NodeShape analyze(const ExpressionNode* node);
+
+static NodeShape analyzeBinary(NodeType type, const NodeShape& a, const NodeShape& b) {
+	if (a.constant && b.constant) {
+		if (!a.known || !b.known) {
+			return constantShape(false, 0.0);
+		}
+		switch (type) {
+		case NodeType::Add:
+			return constantShape(true, a.value + b.value);
+		case NodeType::Sub:
+			return constantShape(true, a.value - b.value);
+		case NodeType::Mul:
+			return constantShape(true, a.value * b.value);
+		case NodeType::Div:
+			return constantShape(true, a.value / b.value);
+		default:
+			return constantShape(true, std::pow(a.value, b.value));
+		}
+	}
+
+	NodeShape shape;
+	shape.period = combinePeriods(a, b);
+	switch (type) {
+	case NodeType::Add:
+	case NodeType::Sub:
+		shape.affine = a.affine && b.affine;
+		shape.slope = type == NodeType::Add ? a.slope + b.slope : a.slope - b.slope;
+		shape.parity = a.parity == b.parity ? a.parity : Parity::None;
+		break;
+	case NodeType::Mul:
+	case NodeType::Div: {
+		// an affine part times a known constant stays affine
+		const NodeShape& factor = a.constant ? a : b;
+		const NodeShape& other = a.constant ? b : a;
+		const bool scalable = factor.constant && factor.known && other.affine && (type == NodeType::Mul || b.constant);
+		if (scalable && factor.value != 0.0) {
+			shape.affine = true;
+			shape.slope = type == NodeType::Mul ? other.slope * factor.value : other.slope / factor.value;
+		}
+		shape.parity = multiplyParity(a.parity, b.parity);
+		break;
+	}
+	case NodeType::Pow:
+		if (b.constant && b.known) {
+			const bool whole = b.value == std::floor(b.value);
+			if (a.parity == Parity::Even) {
+				shape.parity = Parity::Even;
+			} else if (a.parity == Parity::Odd && whole) {
+				shape.parity = std::fmod(b.value, 2.0) == 0.0 ? Parity::Even : Parity::Odd;
+			}
+		} else if (a.parity == Parity::Even && b.parity == Parity::Even) {
+			shape.parity = Parity::Even;
+		}
+		break;
+	default:
+		break;
+	}
+	if (shape.affine && shape.slope == 0.0) {
+		shape.affine = false; // x - x and the like, not worth knowing
+	}
+	return shape;
+}
+
+static NodeShape analyzeFunction(Builtin builtin, const NodeShape& argument) {
+	if (argument.constant) {
+		return constantShape(false, 0.0);
+	}
+	NodeShape shape;
+	shape.period = argument.period;
+	if (argument.affine && argument.slope != 0.0) {
+		if (builtin == Builtin::Sin || builtin == Builtin::Cos) {
+			shape.period = 2.0 * pi / std::abs(argument.slope);
+		} else if (builtin == Builtin::Tan) {
+			shape.period = pi / std::abs(argument.slope);
+		}
+	}
+
+	switch (builtin) {
+	case Builtin::Sin:
+	case Builtin::Tan:
+	case Builtin::Asin:
+	case Builtin::Atan:
+	case Builtin::Sinh:
+	case Builtin::Tanh:
+	case Builtin::Round: // halfway cases round away from zero, so round(-x) == -round(x)
+		shape.parity = argument.parity;
+		break;
+	case Builtin::Cos:
+	case Builtin::Cosh:
+	case Builtin::Fabs:
+		shape.parity = argument.parity == Parity::None ? Parity::None : Parity::Even;
+		break;
+	default:
+		shape.parity = argument.parity == Parity::Even ? Parity::Even : Parity::None;
+		break;
+	}
+	return shape;
+}
+
+static NodeShape analyze(const ExpressionNode* node) {
+	switch (node->type) {
+	case NodeType::Number:
+		return constantShape(true, node->number);
+	case NodeType::Variable: {
+		NodeShape shape;
+		shape.affine = true;
+		shape.slope = 1.0;
+		shape.parity = Parity::Odd;
+		return shape;
+	}
+	case NodeType::Positive:
+		return analyze(node->unary.operand);
+	case NodeType::Negative: {
+		NodeShape shape = analyze(node->unary.operand);
+		shape.value = -shape.value;
+		shape.slope = -shape.slope;
+		return shape;
+	}
+	case NodeType::Pow: {
+		// the JIT folds a constant power first and turns (a ^ b) ^ c into a ^ (b c) after that
+		double folded;
+		if (foldConstantTree(node, folded)) {
+			return constantShape(true, folded);
+		}
+		if (node->binary.left->type == NodeType::Pow) {
+			const ExpressionNode* inner = node->binary.left;
+			const NodeShape exponent =
+				analyzeBinary(NodeType::Mul, analyze(inner->binary.right), analyze(node->binary.right));
+			return analyzeBinary(NodeType::Pow, analyze(inner->binary.left), exponent);
+		}
+		[[fallthrough]];
+	}
+	case NodeType::Add:
+	case NodeType::Sub:
+	case NodeType::Mul:
+	case NodeType::Div:
+		return analyzeBinary(node->type, analyze(node->binary.left), analyze(node->binary.right));
+	case NodeType::Function:
+		return analyzeFunction(node->function.id, analyze(node->function.argument));
+	default:
+		return {};
+	}
+}
+
+#pragma endregion
+#pragma region majorFunctions
+
+ExpressionSymmetry analyzeSymmetry(const ExpressionNode* root) {
+	ExpressionSymmetry symmetry{};
+	if (root == nullptr) {
+		return symmetry;
+	}
+	const NodeShape shape = analyze(root);
+	if (shape.constant) {
+		return symmetry; // flat, the interval bounds make it cheap already
+	}
+	if (std::isfinite(shape.period) && shape.period > 0.0) {
+		symmetry.period = shape.period;
+	}
+	symmetry.parity = shape.parity;
+	return symmetry;
+}
+
+#pragma endregion
@@ -0,0 +1,188 @@
+#include "incrementalParser.hpp"
+#include <algorithm>
+
+// a token looks at most this many characters past its end, for the exponent in 1e+5 or the hex prefix in 0x.f
+static constexpr size_t maxLexerLookahead = 3;
+// once the memo holds this many times the entries of a fresh parse, the garbage of old edits is dropped
+static constexpr size_t rebuildGarbageFactor = 4;
+
+IncrementalParser::~IncrementalParser() {
+	if (nodeArena.begin != nullptr) {
+		arena_free(&nodeArena);
+	}
+}
+
+// the tokens point into cleanExpression, which may live inside the string object itself,
+// so only the arena is taken over and the next parse starts from scratch
+IncrementalParser::IncrementalParser(IncrementalParser&& other) noexcept {
+	std::swap(nodeArena, other.nodeArena);
+	other.clear();
+}
+
+IncrementalParser& IncrementalParser::operator=(IncrementalParser&& other) noexcept {
+	if (this != &other) {
+		std::swap(nodeArena, other.nodeArena);
+		clear();
+		other.clear();
+	}
+	return *this;
+}
+
+void IncrementalParser::clear() {
+	cleanExpression.clear();
+	tokens.clear();
+	memo.clear();
+	tree = nullptr;
+	hasError = true;
+	parenthesesBalance = 0;
+	memoEntriesAfterRebuild = 0;
+	if (nodeArena.begin != nullptr) {
+		arena_reset(&nodeArena);
+	}
+}
+
+ExpressionNode* IncrementalParser::parse(const std::string& input) {
+	scratchExpression.clear();
+	Lexer::lexerRemoveWhitespace(input, scratchExpression);
+
+	if (!tokens.empty() && scratchExpression == cleanExpression) {
+		return hasError ? nullptr : tree;
+	}
+
+	const bool tooMuchGarbage = memo.entries.size() > rebuildGarbageFactor * memoEntriesAfterRebuild + 1024;
+	if (tokens.empty() || tooMuchGarbage) {
+		if (nodeArena.begin == nullptr) {
+			arena_init(&nodeArena);
+		} else {
+			arena_reset(&nodeArena);
+		}
+		cleanExpression = scratchExpression;
+		lexAll();
+		memo.reset(tokens.size());
+		tree = runParser();
+		memoEntriesAfterRebuild = memo.entries.size();
+	} else {
+		relex();
+		tree = runParser();
+	}
+	return hasError ? nullptr : tree;
+}
+
+void IncrementalParser::lexAll() {
+	tokens.clear();
+	Lexer lexer(cleanExpression, 0);
+	Token tk;
+	do {
+		tk = lexer.lexerNextToken();
+		tokens.push_back(tk);
+	} while (tk.type != TokenType::tkEOF);
+	parenthesesBalance = lexer.parenthesesBalance;
+}
+
+static int parenthesesBalanceOf(const Token* begin, const Token* end) {
+	int balance = 0;
+	for (const Token* tk = begin; tk != end; tk++) {
+		balance += (tk->type == TokenType::OpenParenthesis) - (tk->type == TokenType::CloseParenthesis);
+	}
+	return balance;
+}
+
+// lexes only the tokens around the difference between cleanExpression and scratchExpression,
+// splices them into tokens and moves cleanExpression to the new text
+void IncrementalParser::relex() {
+	const std::string_view oldText = cleanExpression;
+	const std::string_view newText = scratchExpression;
+
+	// the edited range is whatever is left between the common prefix and the common suffix
+	const size_t commonLength = std::min(oldText.size(), newText.size());
+	const size_t prefix = std::mismatch(oldText.begin(), oldText.begin() + commonLength, newText.begin()).first -
+						  oldText.begin();
+	size_t suffix = 0;
+	while (suffix < commonLength - prefix &&
+		   oldText[oldText.size() - 1 - suffix] == newText[newText.size() - 1 - suffix]) {
+		suffix++;
+	}
+	const size_t oldEditEnd = oldText.size() - suffix;
+	const size_t newEditEnd = newText.size() - suffix;
+	const ptrdiff_t delta = static_cast<ptrdiff_t>(newText.size()) - static_cast<ptrdiff_t>(oldText.size());
+
+	const auto oldOffsetOf = [&](const Token& tk) { return static_cast<size_t>(tk.lexme.data() - oldText.data()); };
+
+	// tokens that end early enough that not even their lookahead reaches the edit stay as they are
+	const size_t firstChanged =
+		std::partition_point(tokens.begin(), tokens.end(),
+							 [&](const Token& tk) {
+								 return oldOffsetOf(tk) + tk.lexme.size() + maxLexerLookahead <= prefix;
+							 }) -
+		tokens.begin();
+	assert(firstChanged < tokens.size()); // tkEOF always ends at the end of the old text
+
+	// lex the new text until a token starts exactly where an old token after the edit started,
+	// from there on the old tokens are the same, just shifted by delta
+	scratchTokens.clear();
+	Lexer lexer(newText, oldOffsetOf(tokens[firstChanged]));
+	size_t resync = firstChanged;
+	while (true) {
+		const size_t position = static_cast<size_t>(lexer.current - newText.data());
+		if (position >= newEditEnd) {
+			const size_t oldPosition = static_cast<size_t>(static_cast<ptrdiff_t>(position) - delta);
+			while (resync < tokens.size() && oldOffsetOf(tokens[resync]) < oldPosition) {
+				resync++;
+			}
+			if (resync < tokens.size() && oldOffsetOf(tokens[resync]) == oldPosition) {
+				break;
+			}
+		}
+		const Token tk = lexer.lexerNextToken();
+		scratchTokens.push_back(tk);
+		if (tk.type == TokenType::tkEOF) {
+			resync = tokens.size();
+			break;
+		}
+	}
+
+	parenthesesBalance += lexer.parenthesesBalance;
+	parenthesesBalance -= parenthesesBalanceOf(tokens.data() + firstChanged, tokens.data() + resync);
+
+	// remember where everything pointed to before the strings change
+	const uintptr_t oldBase = reinterpret_cast<uintptr_t>(oldText.data());
+	const uintptr_t scratchBase = reinterpret_cast<uintptr_t>(newText.data());
+
+	cleanExpression.replace(prefix, oldEditEnd - prefix, newText.substr(prefix, newEditEnd - prefix));
+	const char* newBase = cleanExpression.data();
+
+	const auto rebase = [&](Token& tk, uintptr_t base, ptrdiff_t shift) {
+		const ptrdiff_t offset = static_cast<ptrdiff_t>(reinterpret_cast<uintptr_t>(tk.lexme.data()) - base) + shift;
+		tk.lexme = std::string_view(newBase + offset, tk.lexme.size());
+	};
+	if (reinterpret_cast<uintptr_t>(newBase) != oldBase) {
+		for (size_t i = 0; i < firstChanged; i++) {
+			rebase(tokens[i], oldBase, 0);
+		}
+	}
+	for (size_t i = resync; i < tokens.size(); i++) {
+		rebase(tokens[i], oldBase, delta);
+	}
+	for (Token& tk : scratchTokens) {
+		rebase(tk, scratchBase, 0);
+	}
+
+	// replace the old tokens [firstChanged, resync) with the new ones
+	const size_t removedCount = resync - firstChanged;
+	if (scratchTokens.size() > removedCount) {
+		tokens.insert(tokens.begin() + resync, scratchTokens.size() - removedCount, Token{});
+	} else if (scratchTokens.size() < removedCount) {
+		tokens.erase(tokens.begin() + firstChanged + scratchTokens.size(), tokens.begin() + resync);
+	}
+	std::copy(scratchTokens.begin(), scratchTokens.end(), tokens.begin() + firstChanged);
+
+	memo.splice(firstChanged, resync, scratchTokens.size());
+	memo.reuseLimit = firstChanged;
+}
+
+ExpressionNode* IncrementalParser::runParser() {
+	Parser parser(tokens.data(), tokens.size(), &nodeArena, &memo);
+	ExpressionNode* result = parser.parserParseExpression();
+	hasError = parser.hasError || parenthesesBalance != 0;
+	return result;
+}
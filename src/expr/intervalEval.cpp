@@ -0,0 +1,525 @@
+#include "intervalEval.hpp"
+#include "parser.hpp"
+#include <algorithm>
+
+#pragma region helperFunction
+
+static constexpr double pi = 3.14159265358979323846;
+static constexpr double ln10 = 2.30258509299404568402;
+
+// libm results are within an ulp or two, one more step outwards on each side keeps the bounds guaranteed
+static inline double down(double x) {
+	return x != x ? -INFINITY : std::nextafter(std::nextafter(x, -INFINITY), -INFINITY);
+}
+
+static inline double up(double x) {
+	return x != x ? INFINITY : std::nextafter(std::nextafter(x, INFINITY), INFINITY);
+}
+
+static inline Interval outward(double lo, double hi) {
+	return {down(lo), up(hi)};
+}
+
+static inline Interval point(double x) {
+	return {x, x};
+}
+
+static inline Interval everything() {
+	return {-INFINITY, INFINITY};
+}
+
+static inline bool contains(Interval a, double x) {
+	return a.lo <= x && x <= a.hi;
+}
+
+// arithmetic on two points is exactly what eval computes, constants stay points that way
+static inline bool arePoints(Interval a, Interval b) {
+	return a.lo == a.hi && b.lo == b.hi;
+}
+
+static inline Interval add(Interval a, Interval b) {
+	if (a.isEmpty() || b.isEmpty()) {
+		return {};
+	}
+	if (arePoints(a, b)) {
+		return point(a.lo + b.lo);
+	}
+	return outward(a.lo + b.lo, a.hi + b.hi);
+}
+
+static inline Interval neg(Interval a) {
+	if (a.isEmpty()) {
+		return {};
+	}
+	return {-a.hi, -a.lo};
+}
+
+static inline Interval sub(Interval a, Interval b) {
+	return add(a, neg(b));
+}
+
+// an endpoint product, 0 times an infinite endpoint is 0 since the endpoint is only approached
+static inline double product(double a, double b) {
+	return a == 0.0 || b == 0.0 ? 0.0 : a * b;
+}
+
+static inline Interval mul(Interval a, Interval b) {
+	if (a.isEmpty() || b.isEmpty()) {
+		return {};
+	}
+	if (arePoints(a, b)) {
+		return point(product(a.lo, b.lo));
+	}
+	const double p[4] = {product(a.lo, b.lo), product(a.lo, b.hi), product(a.hi, b.lo), product(a.hi, b.hi)};
+	return outward(*std::min_element(p, p + 4), *std::max_element(p, p + 4));
+}
+
+static inline Interval scale(Interval a, double factor) {
+	return mul(a, point(factor));
+}
+
+// 1 / a, partial is set when a holds 0 where 1 / a has no finite value
+static Interval reciprocal(Interval a, bool& partial) {
+	if (a.isEmpty()) {
+		return {};
+	}
+	if (a.lo > 0.0 || a.hi < 0.0) {
+		return outward(1.0 / a.hi, 1.0 / a.lo);
+	}
+	partial = true;
+	if (a.lo == 0.0 && a.hi == 0.0) {
+		return {};
+	}
+	if (a.lo == 0.0) {
+		return {down(1.0 / a.hi), INFINITY};
+	}
+	if (a.hi == 0.0) {
+		return {-INFINITY, up(1.0 / a.lo)};
+	}
+	return everything();
+}
+
+static inline Interval div(Interval a, Interval b, bool& partial) {
+	return mul(a, reciprocal(b, partial));
+}
+
+static inline Interval sqr(Interval a) {
+	if (a.isEmpty()) {
+		return {};
+	}
+	const double lo = std::abs(a.lo);
+	const double hi = std::abs(a.hi);
+	if (contains(a, 0.0)) {
+		return {0.0, up(std::max(lo, hi) * std::max(lo, hi))};
+	}
+	return outward(std::min(lo, hi) * std::min(lo, hi), std::max(lo, hi) * std::max(lo, hi));
+}
+
+// the part of a inside of [lo, hi], partial is set if something was cut off
+static inline Interval restrict(Interval a, double lo, double hi, bool& partial) {
+	if (a.isEmpty()) {
+		return {};
+	}
+	partial |= a.lo < lo || a.hi > hi;
+	return {std::max(a.lo, lo), std::min(a.hi, hi)};
+}
+
+// f is increasing or decreasing over a
+static inline Interval monotone(Interval a, double (*f)(double), bool increasing) {
+	if (a.isEmpty()) {
+		return {};
+	}
+	return increasing ? outward(f(a.lo), f(a.hi)) : outward(f(a.hi), f(a.lo));
+}
+
+// sin of a, the extrema inside of a are found from the number of the period they are in
+static Interval intervalSin(Interval a) {
+	if (a.isEmpty()) {
+		return {};
+	}
+	if (!a.isBounded() || a.hi - a.lo >= 2.0 * pi) {
+		return {-1.0, 1.0};
+	}
+	double lo = std::min(std::sin(a.lo), std::sin(a.hi));
+	double hi = std::max(std::sin(a.lo), std::sin(a.hi));
+	// maxima at pi / 2 + 2k pi, minima at -pi / 2 + 2k pi
+	if (std::floor((a.hi - 0.5 * pi) / (2.0 * pi)) >= std::ceil((a.lo - 0.5 * pi) / (2.0 * pi))) {
+		hi = 1.0;
+	}
+	if (std::floor((a.hi + 0.5 * pi) / (2.0 * pi)) >= std::ceil((a.lo + 0.5 * pi) / (2.0 * pi))) {
+		lo = -1.0;
+	}
+	const Interval result = outward(lo, hi);
+	return {std::max(result.lo, -1.0), std::min(result.hi, 1.0)};
+}
+
+static Interval intervalCos(Interval a) {
+	if (a.isEmpty()) {
+		return {};
+	}
+	if (!a.isBounded() || a.hi - a.lo >= 2.0 * pi) {
+		return {-1.0, 1.0};
+	}
+	double lo = std::min(std::cos(a.lo), std::cos(a.hi));
+	double hi = std::max(std::cos(a.lo), std::cos(a.hi));
+	// maxima at 2k pi, minima at pi + 2k pi
+	if (std::floor(a.hi / (2.0 * pi)) >= std::ceil(a.lo / (2.0 * pi))) {
+		hi = 1.0;
+	}
+	if (std::floor((a.hi - pi) / (2.0 * pi)) >= std::ceil((a.lo - pi) / (2.0 * pi))) {
+		lo = -1.0;
+	}
+	const Interval result = outward(lo, hi);
+	return {std::max(result.lo, -1.0), std::min(result.hi, 1.0)};
+}
+
+// tan is increasing between its poles at pi / 2 + k pi, over a pole it takes every value
+static Interval intervalTan(Interval a) {
+	if (a.isEmpty()) {
+		return {};
+	}
+	if (!a.isBounded() || a.hi - a.lo >= pi ||
+		std::floor((a.hi - 0.5 * pi) / pi) >= std::ceil((a.lo - 0.5 * pi) / pi)) {
+		return everything();
+	}
+	return outward(std::tan(a.lo), std::tan(a.hi));
+}
+
+static Interval intervalCosh(Interval a) {
+	if (a.isEmpty()) {
+		return {};
+	}
+	if (contains(a, 0.0)) {
+		return {1.0, up(std::cosh(std::max(-a.lo, a.hi)))};
+	}
+	return a.lo > 0.0 ? monotone(a, std::cosh, true) : monotone(a, std::cosh, false);
+}
+
+static Interval intervalFabs(Interval a) {
+	if (a.isEmpty()) {
+		return {};
+	}
+	if (a.lo >= 0.0) {
+		return a;
+	}
+	if (a.hi <= 0.0) {
+		return neg(a);
+	}
+	return {0.0, std::max(-a.lo, a.hi)};
+}
+
+static Interval intervalExp(Interval a) {
+	if (a.isEmpty()) {
+		return {};
+	}
+	const Interval result = monotone(a, std::exp, true);
+	return {std::max(result.lo, 0.0), result.hi};
+}
+
+// a ^ exponent for a constant exponent, a negative base only has a value for whole exponents
+static Interval powInterval(Interval a, double exponent, bool& partial) {
+	if (a.isEmpty()) {
+		return {};
+	}
+	const bool whole = exponent == std::floor(exponent) && std::abs(exponent) < 0x1.0p53;
+	if (exponent == 0.0) {
+		return point(1.0);
+	}
+	if (whole) {
+		const bool odd = std::fmod(exponent, 2.0) != 0.0;
+		Interval magnitude;
+		if (odd) {
+			magnitude = outward(std::pow(a.lo, std::abs(exponent)), std::pow(a.hi, std::abs(exponent)));
+		} else {
+			const Interval absolute = intervalFabs(a);
+			magnitude = outward(std::pow(absolute.lo, std::abs(exponent)), std::pow(absolute.hi, std::abs(exponent)));
+			magnitude.lo = std::max(magnitude.lo, 0.0);
+		}
+		return exponent > 0.0 ? magnitude : reciprocal(magnitude, partial);
+	}
+	const Interval base = restrict(a, 0.0, INFINITY, partial);
+	if (base.isEmpty()) {
+		return {};
+	}
+	if (exponent < 0.0 && base.lo == 0.0) {
+		partial = true; // 0 ^ negative is infinite
+	}
+	Interval result = exponent > 0.0 ? outward(std::pow(base.lo, exponent), std::pow(base.hi, exponent))
+									 : outward(std::pow(base.hi, exponent), std::pow(base.lo, exponent));
+	result.lo = std::max(result.lo, 0.0);
+	return result;
+}
+
+static Interval intervalLog(Interval a, bool& partial) {
+	const Interval positive = restrict(a, 0.0, INFINITY, partial);
+	if (positive.isEmpty() || positive.hi == 0.0) {
+		partial = true;
+		return {};
+	}
+	if (positive.lo == 0.0) {
+		partial = true; // log(0) is -inf
+	}
+	return monotone(positive, std::log, true);
+}
+
+// a value with its derivative, forward mode differentiation on intervals
+struct Dual {
+	Interval value;
+	Interval slope;
+};
+
+// chain rule, outer is the derivative of the function at the argument
+static inline Dual chain(Interval value, Interval outer, const Dual& argument) {
+	if (value.isEmpty()) {
+		return {};
+	}
+	return {value, mul(outer, argument.slope)};
+}
+
+// a step function of the argument, constant where it has no step
+static inline Dual step(const Dual& argument, double (*f)(double)) {
+	const Interval value = monotone(argument.value, f, true);
+	if (value.isEmpty()) {
+		return {};
+	}
+	const double lo = f(argument.value.lo);
+	const double hi = f(argument.value.hi);
+	return {{lo, hi}, lo == hi ? point(0.0) : everything()};
+}
+
+static Dual evaluateFunction(Builtin builtin, const Dual& a, bool& partial) {
+	const Interval x = a.value;
+	switch (builtin) {
+	case Builtin::Sin:
+		return chain(intervalSin(x), intervalCos(x), a);
+	case Builtin::Cos:
+		return chain(intervalCos(x), neg(intervalSin(x)), a);
+	case Builtin::Tan: {
+		const Interval value = intervalTan(x);
+		return chain(value, add(point(1.0), sqr(value)), a);
+	}
+	case Builtin::Asin:
+	case Builtin::Acos: {
+		const Interval domain = restrict(x, -1.0, 1.0, partial);
+		const bool isAsin = builtin == Builtin::Asin;
+		double (*const f)(double) = isAsin ? static_cast<double (*)(double)>(std::asin)
+													  : static_cast<double (*)(double)>(std::acos);
+		const Interval value = monotone(domain, f, isAsin);
+		// 1 / sqrt(1 - x^2), infinite at the ends of the domain
+		bool edge = false;
+		const Interval root = monotone(restrict(sub(point(1.0), sqr(domain)), 0.0, INFINITY, edge), std::sqrt, true);
+		const Interval outer = reciprocal(root, edge);
+		return chain(value, isAsin ? outer : neg(outer), a);
+	}
+	case Builtin::Atan: {
+		bool never = false; // 1 + x^2 is never 0
+		return chain(monotone(x, std::atan, true), reciprocal(add(point(1.0), sqr(x)), never), a);
+	}
+	case Builtin::Sinh:
+		return chain(monotone(x, std::sinh, true), intervalCosh(x), a);
+	case Builtin::Cosh:
+		return chain(intervalCosh(x), monotone(x, std::sinh, true), a);
+	case Builtin::Tanh: {
+		const Interval value = monotone(x, std::tanh, true);
+		return chain(value, sub(point(1.0), sqr(value)), a);
+	}
+	case Builtin::Log:
+	case Builtin::Log10: {
+		const Interval value = intervalLog(x, partial);
+		const double factor = builtin == Builtin::Log ? 1.0 : 1.0 / ln10;
+		bool zero = false;
+		const Interval outer = reciprocal(restrict(x, 0.0, INFINITY, zero), zero);
+		return chain(builtin == Builtin::Log ? value : scale(value, factor), scale(outer, factor), a);
+	}
+	case Builtin::Sqrt: {
+		const Interval domain = restrict(x, 0.0, INFINITY, partial);
+		const Interval value = monotone(domain, std::sqrt, true);
+		bool zero = false;
+		return chain({std::max(value.lo, 0.0), value.hi}, scale(reciprocal(value, zero), 0.5), a);
+	}
+	case Builtin::Ceil:
+		return step(a, std::ceil);
+	case Builtin::Floor:
+		return step(a, std::floor);
+	case Builtin::Round:
+		return step(a, std::round);
+	case Builtin::Fabs: {
+		const Interval sign = x.lo >= 0.0 ? point(1.0) : (x.hi <= 0.0 ? point(-1.0) : Interval{-1.0, 1.0});
+		return chain(intervalFabs(x), sign, a);
+	}
+	default:
+		break;
+	}
+	partial = true;
+	return {everything(), everything()};
+}
+
+// the ^ operator, a ^ b for a constant b keeps negative bases, otherwise it is exp(b log(a))
+static Dual evaluatePow(const Dual& a, const Dual& b, bool& partial) {
+	if (b.value.lo == b.value.hi && b.slope.lo == 0.0 && b.slope.hi == 0.0) {
+		const double exponent = b.value.lo;
+		const Interval value = powInterval(a.value, exponent, partial);
+		bool zero = false;
+		const Interval outer = scale(powInterval(a.value, exponent - 1.0, zero), exponent);
+		return chain(value, outer, a);
+	}
+	bool zero = false;
+	const Interval logA = intervalLog(a.value, partial);
+	const Interval value = intervalExp(mul(b.value, logA));
+	// (a^b)' = a^b (b' log(a) + b a' / a)
+	const Interval inner = add(mul(b.slope, logA), mul(b.value, div(a.slope, a.value, zero)));
+	if (value.isEmpty()) {
+		return {};
+	}
+	return {value, mul(value, inner)};
+}
+
+#pragma endregion
+#pragma region majorFunctions
+
+bool IntervalFunction::emitCode(const ExpressionNode* node, size_t depth) {
+	if (depth + 1 >= maxStack) {
+		return false;
+	}
+	switch (node->type) {
+	case NodeType::Number:
+		code.push_back({NodeType::Number, Builtin::None, node->number});
+		return true;
+	case NodeType::Variable:
+		code.push_back({NodeType::Variable, Builtin::None, 0.0});
+		return true;
+	case NodeType::Positive:
+		return emitCode(node->unary.operand, depth);
+	case NodeType::Negative:
+		if (!emitCode(node->unary.operand, depth)) {
+			return false;
+		}
+		code.push_back({NodeType::Negative, Builtin::None, 0.0});
+		return true;
+	case NodeType::Pow: {
+		// the JIT folds a constant power first and turns (a ^ b) ^ c into a ^ (b c) after that,
+		// the bounds have to be of the same function
+		double folded;
+		if (foldConstantTree(node, folded)) {
+			code.push_back({NodeType::Number, Builtin::None, folded});
+			return true;
+		}
+		if (node->binary.left->type == NodeType::Pow) {
+			const ExpressionNode* inner = node->binary.left;
+			if (!emitCode(inner->binary.left, depth) || !emitCode(inner->binary.right, depth + 1) ||
+				!emitCode(node->binary.right, depth + 2)) {
+				return false;
+			}
+			code.push_back({NodeType::Mul, Builtin::None, 0.0});
+			code.push_back({NodeType::Pow, Builtin::None, 0.0});
+			return true;
+		}
+		[[fallthrough]];
+	}
+	case NodeType::Add:
+	case NodeType::Sub:
+	case NodeType::Mul:
+	case NodeType::Div:
+		if (!emitCode(node->binary.left, depth) || !emitCode(node->binary.right, depth + 1)) {
+			return false;
+		}
+		code.push_back({node->type, Builtin::None, 0.0});
+		return true;
+	case NodeType::Function:
+		if (!emitCode(node->function.argument, depth)) {
+			return false;
+		}
+		code.push_back({NodeType::Function, node->function.id, 0.0});
+		return true;
+	default:
+		return false;
+	}
+}
+
+bool IntervalFunction::compile(const ExpressionNode* root) {
+	code.clear();
+	if (root == nullptr || !emitCode(root, 0)) {
+		code.clear();
+		return false;
+	}
+	return true;
+}
+
+void IntervalFunction::clear() {
+	code.clear();
+}
+
+IntervalBounds IntervalFunction::evaluate(double xLo, double xHi) const {
+	IntervalBounds bounds{};
+	if (code.empty()) {
+		bounds.value = everything();
+		bounds.slope = everything();
+		bounds.partial = true;
+		return bounds;
+	}
+
+	Dual stack[maxStack];
+	size_t top = 0;
+	bool partial = false;
+	for (const Instruction& instruction : code) {
+		switch (instruction.type) {
+		case NodeType::Number:
+			stack[top++] = {point(instruction.number), point(0.0)};
+			break;
+		case NodeType::Variable:
+			stack[top++] = {{xLo, xHi}, point(1.0)};
+			break;
+		case NodeType::Negative:
+			stack[top - 1] = {neg(stack[top - 1].value), neg(stack[top - 1].slope)};
+			break;
+		case NodeType::Add:
+		case NodeType::Sub: {
+			const Dual& a = stack[top - 2];
+			const Dual& b = stack[top - 1];
+			const bool isAdd = instruction.type == NodeType::Add;
+			stack[top - 2] = {isAdd ? add(a.value, b.value) : sub(a.value, b.value),
+							  isAdd ? add(a.slope, b.slope) : sub(a.slope, b.slope)};
+			top--;
+			break;
+		}
+		case NodeType::Mul: {
+			const Dual& a = stack[top - 2];
+			const Dual& b = stack[top - 1];
+			stack[top - 2] = {mul(a.value, b.value), add(mul(a.slope, b.value), mul(a.value, b.slope))};
+			top--;
+			break;
+		}
+		case NodeType::Div: {
+			const Dual& a = stack[top - 2];
+			const Dual& b = stack[top - 1];
+			const Interval value = div(a.value, b.value, partial);
+			// (a / b)' = (a' - (a / b) b') / b
+			bool zero = false;
+			const Interval slope = div(sub(a.slope, mul(value, b.slope)), b.value, zero);
+			stack[top - 2] = {value, slope};
+			top--;
+			break;
+		}
+		case NodeType::Pow:
+			stack[top - 2] = evaluatePow(stack[top - 2], stack[top - 1], partial);
+			top--;
+			break;
+		case NodeType::Function:
+			stack[top - 1] = evaluateFunction(instruction.builtin, stack[top - 1], partial);
+			break;
+		default:
+			break;
+		}
+	}
+
+	bounds.value = stack[0].value;
+	bounds.slope = stack[0].slope;
+	bounds.partial = partial || bounds.value.isEmpty();
+	// where the value is unbounded the derivative means nothing
+	if (!bounds.value.isBounded()) {
+		bounds.slope = everything();
+	}
+	return bounds;
+}
+
+#pragma endregion
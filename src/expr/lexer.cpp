@@ -1,9 +1,15 @@
 #include "lexer.hpp"
 #include "defines.hpp"
 #include <string_view>
-#include <ctype.h>
 #include <iostream>
 #include <algorithm>
+#include <chrono>
+#include <cstring>
+#include "tools.hpp"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
 
 #pragma region helperFunction
 
@@ -11,19 +17,149 @@
 	return {type, std::string_view(start, static_cast<size_t>(current - start))};
 }
 
+#if defined(__AVX2__)
+static inline uint32_t countTrailingZeros(uint32_t value) {
+#if COMPILER_MSVC
+	unsigned long index = 0;
+	_BitScanForward(&index, value);
+	return index;
+#else
+	return __builtin_ctz(value);
+#endif
+}
+
+// returns a mask where bit i is set if p[i] is in one of the classes of classMask
+// bytes >= 0x80 are negative in the signed compares below, so they never match
+static inline uint32_t classifyBlock(const char* p, uint8_t classMask) {
+	const __m256i chars = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+	__m256i result = _mm256_setzero_si256();
+
+	if (classMask & CharClassDigit) {
+		const __m256i aboveMin = _mm256_cmpgt_epi8(chars, _mm256_set1_epi8('0' - 1));
+		const __m256i belowMax = _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), chars);
+		result = _mm256_or_si256(result, _mm256_and_si256(aboveMin, belowMax));
+	}
+	if (classMask & (CharClassAlpha | CharClassHexDigit)) {
+		// setting the 0x20 bit maps upper case onto lower case
+		const __m256i lower = _mm256_or_si256(chars, _mm256_set1_epi8(0x20));
+		const __m256i aboveMin = _mm256_cmpgt_epi8(lower, _mm256_set1_epi8('a' - 1));
+		const char maxLetter = (classMask & CharClassAlpha) ? 'z' : 'f';
+		const __m256i belowMax = _mm256_cmpgt_epi8(_mm256_set1_epi8(maxLetter + 1), lower);
+		result = _mm256_or_si256(result, _mm256_and_si256(aboveMin, belowMax));
+	}
+	if (classMask & CharClassHexDigit) {
+		const __m256i aboveMin = _mm256_cmpgt_epi8(chars, _mm256_set1_epi8('0' - 1));
+		const __m256i belowMax = _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), chars);
+		result = _mm256_or_si256(result, _mm256_and_si256(aboveMin, belowMax));
+	}
+	if (classMask & CharClassSpace) {
+		// ' ' and '\t' '\n' '\v' '\f' '\r' which are the range [9, 13]
+		const __m256i isBlank = _mm256_cmpeq_epi8(chars, _mm256_set1_epi8(' '));
+		const __m256i aboveMin = _mm256_cmpgt_epi8(chars, _mm256_set1_epi8('\t' - 1));
+		const __m256i belowMax = _mm256_cmpgt_epi8(_mm256_set1_epi8('\r' + 1), chars);
+		result = _mm256_or_si256(result, _mm256_or_si256(isBlank, _mm256_and_si256(aboveMin, belowMax)));
+	}
+	return static_cast<uint32_t>(_mm256_movemask_epi8(result));
+}
+
+// for every 8 bit keep mask, the shuffle that packs the kept bytes to the front and how many were kept
+struct CompactEntry {
+	uint8_t shuffle[8];
+	uint8_t count;
+};
+
+static constexpr std::array<CompactEntry, 256> makeCompactTable() {
+	std::array<CompactEntry, 256> table{};
+	for (int mask = 0; mask < 256; mask++) {
+		uint8_t count = 0;
+		for (uint8_t bit = 0; bit < 8; bit++) {
+			if (mask & (1 << bit)) {
+				table[mask].shuffle[count++] = bit;
+			}
+		}
+		for (uint8_t i = count; i < 8; i++) {
+			table[mask].shuffle[i] = 0x80; // zero the unused bytes
+		}
+		table[mask].count = count;
+	}
+	return table;
+}
+
+static constexpr std::array<CompactEntry, 256> compactTable = makeCompactTable();
+#endif
+
+void Lexer::lexerAdvanceWhile(uint8_t classMask) {
+	// most tokens are only a few characters long, so only go wide once the run is long enough to pay for it
+	for (int i = 0; i < 8; i++) {
+		if (!isCharClass(*current, classMask)) {
+			return;
+		}
+		current++;
+	}
+#if defined(__AVX2__)
+	while (end - current >= 32) {
+		const uint32_t matching = classifyBlock(current, classMask);
+		if (matching != 0xFFFFFFFF) {
+			current += countTrailingZeros(~matching);
+			return;
+		}
+		current += 32;
+	}
+#endif
+	// the null terminator has no class, so this stops at the end
+	while (isCharClass(*current, classMask)) {
+		current++;
+	}
+}
+
+void Lexer::lexerRemoveWhitespace(std::string_view src, std::string& out) {
+	const size_t oldSize = out.size();
+	out.resize(oldSize + src.size());
+	char* dst = out.data() + oldSize;
+	const char* p = src.data();
+	const char* srcEnd = p + src.size();
+
+#if defined(__AVX2__)
+	// dst never passes p, so the 8 byte stores below always stay inside out
+	for (; srcEnd - p >= 32; p += 32) {
+		const uint32_t keep = ~classifyBlock(p, CharClassSpace);
+		if (keep == 0xFFFFFFFF) {
+			memcpy(dst, p, 32);
+			dst += 32;
+			continue;
+		}
+		for (int group = 0; group < 4; group++) {
+			const CompactEntry& entry = compactTable[(keep >> (group * 8)) & 0xFF];
+			const __m128i bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p + group * 8));
+			const __m128i shuffle = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(entry.shuffle));
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(dst), _mm_shuffle_epi8(bytes, shuffle));
+			dst += entry.count;
+		}
+	}
+#endif
+	for (; p != srcEnd; p++) {
+		*dst = *p;
+		dst += !isCharClass(*p, CharClassSpace);
+	}
+	out.resize(static_cast<size_t>(dst - out.data()));
+}
+
 #pragma endregion
 
 #pragma region majorFunctions
 
 Lexer::Lexer(const std::string& expression) {
-	cleanExpression.reserve(expression.size());
-	for (char c : expression) {
-		if (!std::isspace(c)) {
-			cleanExpression += c;
-		}
-	}
+	lexerRemoveWhitespace(expression, cleanExpression);
 	start = cleanExpression.c_str();
 	current = start;
+	end = start + cleanExpression.size();
+}
+
+Lexer::Lexer(std::string_view cleanText, size_t position) {
+	assert(cleanText.data()[cleanText.size()] == '\0');
+	start = cleanText.data() + position;
+	current = start;
+	end = cleanText.data() + cleanText.size();
 }
 
 std::optional<std::vector<Token, ArenaAllocator<Token>>> Lexer::lexerLexAllTokens() {
@@ -79,28 +215,66 @@ Token Lexer::lexerNextToken() {
 	case '7':
 	case '8':
 	case '9': {
-		lexerAdvanceTillConditionFail(static_cast<int (*)(int)>(std::isdigit));
-
-		if (*current == '.') {
-			current++;
-			lexerAdvanceTillConditionFail(static_cast<int (*)(int)>(std::isdigit));
-		}
+		lexerLexNumber(currentChar);
 		return lexerMakeToken(TokenType::Number);
 	}
 
 	default:
-		if (std::isalpha(currentChar)) {
-			lexerAdvanceTillConditionFail(static_cast<int (*)(int)>(std::isdigit),
-										  static_cast<int (*)(int)>(std::isalpha));
-			return lexerMakeToken(TokenType::Ident);
+		if (isCharClass(currentChar, CharClassAlpha)) {
+			lexerAdvanceWhile(CharClassIdent);
+			Token tk = lexerMakeToken(TokenType::Ident);
+			tk.builtin = lookupBuiltin(tk.lexme);
+			return tk;
 		} else {
-			current++;
+			// never step past the null terminator
+			if (current != end) {
+				current++;
+			}
 			return lexerMakeToken(TokenType::Error);
 		}
 	}
 	unreachable();
 }
 
+void Lexer::lexerLexNumber(char firstDigit) {
+	// 0x needs a hex digit after it, otherwise it stays the implicit multiplication 0*x
+	const bool isHex = firstDigit == '0' && (*current == 'x' || *current == 'X') &&
+					   (isCharClass(current[1], CharClassHexDigit) ||
+						(current[1] == '.' && isCharClass(current[2], CharClassHexDigit)));
+	if (isHex) {
+		current++;
+		lexerAdvanceWhile(CharClassHexDigit);
+		if (*current == '.') {
+			current++;
+			lexerAdvanceWhile(CharClassHexDigit);
+		}
+		lexerLexExponent('p', 'P');
+		return;
+	}
+
+	lexerAdvanceWhile(CharClassDigit);
+	if (*current == '.') {
+		current++;
+		lexerAdvanceWhile(CharClassDigit);
+	}
+	// 2e stays 2*e, only 2e5 or 2e-5 are exponents
+	lexerLexExponent('e', 'E');
+}
+
+void Lexer::lexerLexExponent(char lower, char upper) {
+	if (*current != lower && *current != upper) {
+		return;
+	}
+	const char* digits = current + 1;
+	if (*digits == '+' || *digits == '-') {
+		digits++;
+	}
+	if (isCharClass(*digits, CharClassDigit)) {
+		current = digits;
+		lexerAdvanceWhile(CharClassDigit);
+	}
+}
+
 std::string Lexer::lexerDebugGetTokenTypeName(TokenType type) {
 	switch (type) {
 	case TokenType::Error:
@@ -145,4 +319,22 @@ void Lexer::lexerDebugPrintToken(Token token) {
 	std::cout << lexerDebugGetTokenTypeName(token.type) << "  " << token.lexme << '\n';
 }
 
+double Lexer::lexerDebugBenchmark(const std::string& text, size_t iterations) {
+	size_t tokenCount = 0;
+	const auto begin = std::chrono::high_resolution_clock::now();
+	for (size_t i = 0; i < iterations; i++) {
+		Lexer lexer(text);
+		Token tk;
+		do {
+			tk = lexer.lexerNextToken();
+			tokenCount++;
+		} while (tk.type != TokenType::tkEOF);
+	}
+	const auto finish = std::chrono::high_resolution_clock::now();
+	const double seconds = std::chrono::duration<double>(finish - begin).count();
+	ilog("lexed", tokenCount, "tokens in", seconds, "seconds");
+
+	return static_cast<double>(text.size()) * iterations / seconds / 1e9;
+}
+
 #pragma endregion
\ No newline at end of file
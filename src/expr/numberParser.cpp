@@ -0,0 +1,169 @@
+#include "numberParser.hpp"
+#include "lexer.hpp"
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+#pragma region helperFunction
+
+// every power of ten up to 1e22 is exactly representable as a double
+static constexpr double exactPowersOfTen[] = {1e0,	1e1,  1e2,	1e3,  1e4,	1e5,  1e6,	1e7,
+											  1e8,	1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+											  1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+static constexpr int64_t maxExactPowerOfTen = 22;
+static constexpr uint64_t maxExactMantissa = uint64_t(1) << 53;
+
+static inline int hexDigitValue(char c) {
+	if (isCharClass(c, CharClassDigit)) {
+		return c - '0';
+	}
+	return (c | 0x20) - 'a' + 10;
+}
+
+// reads [+-]digits, saturating so huge exponents still end up as inf or 0
+static const char* parseExponent(const char* p, const char* end, int64_t& exponent) {
+	bool negative = false;
+	if (p != end && (*p == '+' || *p == '-')) {
+		negative = *p == '-';
+		p++;
+	}
+	int64_t value = 0;
+	for (; p != end && isCharClass(*p, CharClassDigit); p++) {
+		if (value < 100000) {
+			value = value * 10 + (*p - '0');
+		}
+	}
+	exponent = negative ? -value : value;
+	return p;
+}
+
+// the exact fallback, used whenever the fast path cannot guarantee a correctly rounded result.
+// overflows tells a value too large for a double from one too small, from where its leading digit is
+static std::optional<double> parseNumberSlow(const char* begin, const char* end, std::chars_format format,
+											 bool overflows) {
+	double value = 0;
+	const std::from_chars_result result = std::from_chars(begin, end, value, format);
+	if (result.ptr != end) {
+		return std::nullopt;
+	}
+	if (result.ec == std::errc::result_out_of_range) {
+		return overflows ? std::numeric_limits<double>::infinity() : 0.0;
+	}
+	if (result.ec != std::errc()) {
+		return std::nullopt;
+	}
+	return value;
+}
+
+static std::optional<double> parseHexNumber(const char* begin, const char* end) {
+	uint64_t mantissa = 0;
+	int64_t exponent = 0;
+	int significantDigits = 0;
+	bool sawDigit = false;
+
+	const char* p = begin;
+	for (; p != end && isCharClass(*p, CharClassHexDigit); p++) {
+		sawDigit = true;
+		if (mantissa != 0 || *p != '0') {
+			significantDigits++;
+		}
+		mantissa = (mantissa << 4) | static_cast<uint64_t>(hexDigitValue(*p));
+	}
+	if (p != end && *p == '.') {
+		p++;
+		for (; p != end && isCharClass(*p, CharClassHexDigit); p++) {
+			sawDigit = true;
+			if (mantissa != 0 || *p != '0') {
+				significantDigits++;
+			}
+			mantissa = (mantissa << 4) | static_cast<uint64_t>(hexDigitValue(*p));
+			exponent -= 4;
+		}
+	}
+	if (!sawDigit) {
+		return std::nullopt;
+	}
+	int64_t binaryExponent = 0;
+	if (p != end && (*p == 'p' || *p == 'P')) {
+		p = parseExponent(p + 1, end, binaryExponent);
+	}
+	if (p != end) {
+		return std::nullopt;
+	}
+
+	// more than 13 hex digits may not fit into the mantissa, let from_chars round it
+	if (significantDigits <= 13 && mantissa <= maxExactMantissa) {
+		return std::ldexp(static_cast<double>(mantissa), static_cast<int>(exponent + binaryExponent));
+	}
+	// the leading digit is worth at least 1 if its last bit is not below the point
+	return parseNumberSlow(begin, end, std::chars_format::hex, exponent + binaryExponent + 4 * significantDigits > 0);
+}
+
+#pragma endregion
+
+std::optional<double> parseNumber(std::string_view lexme) {
+	const char* begin = lexme.data();
+	const char* end = begin + lexme.size();
+	if (begin == end) {
+		return std::nullopt;
+	}
+	if (lexme.size() > 2 && begin[0] == '0' && (begin[1] == 'x' || begin[1] == 'X')) {
+		return parseHexNumber(begin + 2, end);
+	}
+
+	// Clinger's fast path: if the decimal mantissa and the power of ten are both exact doubles
+	// a single multiplication or division is correctly rounded
+	uint64_t mantissa = 0;
+	int64_t exponent = 0;
+	int significantDigits = 0;
+	bool sawDigit = false;
+
+	const char* p = begin;
+	for (; p != end && isCharClass(*p, CharClassDigit); p++) {
+		sawDigit = true;
+		if (mantissa != 0 || *p != '0') {
+			significantDigits++;
+		}
+		mantissa = mantissa * 10 + static_cast<uint64_t>(*p - '0');
+	}
+	if (p != end && *p == '.') {
+		p++;
+		for (; p != end && isCharClass(*p, CharClassDigit); p++) {
+			sawDigit = true;
+			if (mantissa != 0 || *p != '0') {
+				significantDigits++;
+			}
+			mantissa = mantissa * 10 + static_cast<uint64_t>(*p - '0');
+			exponent--;
+		}
+	}
+	if (!sawDigit) {
+		return std::nullopt;
+	}
+	int64_t explicitExponent = 0;
+	if (p != end && (*p == 'e' || *p == 'E')) {
+		p = parseExponent(p + 1, end, explicitExponent);
+	}
+	if (p != end) {
+		return std::nullopt;
+	}
+	exponent += explicitExponent;
+
+	// 19 digits always fit into an uint64_t without wrapping
+	if (significantDigits <= 19 && mantissa <= maxExactMantissa) {
+		const double value = static_cast<double>(mantissa);
+		if (mantissa == 0) {
+			return 0.0;
+		}
+		if (0 <= exponent && exponent <= maxExactPowerOfTen) {
+			return value * exactPowersOfTen[exponent];
+		}
+		if (-maxExactPowerOfTen <= exponent && exponent < 0) {
+			return value / exactPowersOfTen[-exponent];
+		}
+	}
+	// the decimal exponent of the leading digit decides, the written exponent alone misses leading zeros and long
+	// integer parts like 0.00...01 and 100...0e-1
+	return parseNumberSlow(begin, end, std::chars_format::general, exponent + significantDigits > 0);
+}
@@ -1,16 +1,15 @@
 #include "parser.hpp"
+#include "numberParser.hpp"
+#include <cmath>
 #include <iostream>
 
-constexpr double pi = 3.14159265358979323846;
-constexpr double E = 2.718281828459045235360;
-
-// all functions from math.h that take 1 parameter
-const std::unordered_set<std::string_view> Parser::functionSet = {"sin",  "cos",  "tan",   "acos", "asin",	"atan",
-																  "cosh", "sinh", "tanh",  "log",  "log10", "sqrt",
-																  "ceil", "fabs", "floor", "round"};
+Parser::Parser(const std::vector<Token, ArenaAllocator<Token>>& arr)
+	: Parser(arr.data(), arr.size(), &global_arena) {
+}
 
-Parser::Parser(const std::vector<Token, ArenaAllocator<Token>>& arr) : tokenArray(arr), tokenIndex(0) {
-	if (!tokenArray.empty()) {
+Parser::Parser(const Token* tokens, size_t count, Arena* nodeArena, ParseMemo* memo)
+	: nodeArena(nodeArena), tokenArray(tokens), tokenCount(count), tokenIndex(0), memo(memo) {
+	if (tokenCount != 0) {
 		curr = tokenArray[tokenIndex];
 		parserAdvance();
 	}
@@ -20,28 +19,43 @@ Parser::~Parser() {
 }
 
 inline void Parser::parserAdvance() {
-	if (tokenIndex < tokenArray.size()) {
+	if (tokenIndex < tokenCount) {
 		curr = tokenArray[tokenIndex];
 		tokenIndex++;
 	} else {
-		curr = tokenArray.back(); // Keep curr pointing to the last token (tkEOF) if out of bounds
+		curr = tokenArray[tokenCount - 1]; // Keep curr pointing to the last token (tkEOF) if out of bounds
 	}
 }
 
+// makes index the current token
+inline void Parser::parserSeek(size_t index) {
+	tokenIndex = index;
+	parserAdvance();
+}
+
+inline ExpressionNode* Parser::parserNewNode() {
+	return static_cast<ExpressionNode*>(arena_alloc(nodeArena, sizeof(ExpressionNode)));
+}
+
 ExpressionNode* Parser::parserParseNumber() {
-	double value = strtod((const char*)curr.lexme.data(), nullptr);
+	std::optional<double> value = parseNumber(curr.lexme);
 	parserAdvance();
 
-	ExpressionNode* ret = nodePool.allocate(1);
+	ExpressionNode* ret = parserNewNode();
+	if (!value.has_value()) {
+		ret->type = NodeType::Error;
+		hasError = true;
+		return ret;
+	}
 	ret->type = NodeType::Number;
-	ret->number = value;
+	ret->number = *value;
 	return ret;
 }
 
 ExpressionNode* Parser::parseFunctionCall() {
-	ExpressionNode* ret = nodePool.allocate(1);
+	ExpressionNode* ret = parserNewNode();
 	ret->type = NodeType::Function;
-	ret->function.name = curr.lexme; // Store the function name
+	ret->function.id = curr.builtin; // Store the function
 
 	parserAdvance(); // Advance past the function name
 
@@ -69,22 +83,20 @@ ExpressionNode* Parser::parseFunctionCall() {
 
 ExpressionNode* Parser::parseIdent() {
 	ExpressionNode* ret = nullptr;
+	const BuiltinInfo& info = getBuiltinInfo(curr.builtin);
 
-	if (functionSet.find(curr.lexme) != functionSet.end()) {
+	// only single argument functions can be called, there is no argument list syntax yet
+	if (info.kind == BuiltinKind::Function && info.arity == 1) {
 		ret = parseFunctionCall(); // Parse as function call
-	} else if (curr.lexme == "e") {
-		ret = nodePool.allocate(1);
+	} else if (info.kind == BuiltinKind::Constant) {
+		ret = parserNewNode();
 		ret->type = NodeType::Number;
-		ret->number = E;
-	} else if (curr.lexme == "pi") {
-		ret = nodePool.allocate(1);
-		ret->type = NodeType::Number;
-		ret->number = pi;
-	} else if (curr.lexme == "x") {
-		ret = nodePool.allocate(1);
+		ret->number = info.value;
+	} else if (info.kind == BuiltinKind::Variable) {
+		ret = parserNewNode();
 		ret->type = NodeType::Variable;
 	} else {
-		ret = nodePool.allocate(1);
+		ret = parserNewNode();
 		ret->type = NodeType::Error;
 		hasError = true;
 	}
@@ -114,20 +126,20 @@ ExpressionNode* Parser::parserParsePrefixExpr() {
 	}
 	case TokenType::Plus: {
 		parserAdvance();
-		ret = nodePool.allocate(1);
+		ret = parserNewNode();
 		ret->type = NodeType::Positive;
 		ret->unary.operand = parserParsePrefixExpr();
 		break;
 	}
 	case TokenType::Minus: {
 		parserAdvance();
-		ret = nodePool.allocate(1);
+		ret = parserNewNode();
 		ret->type = NodeType::Negative;
 		ret->unary.operand = parserParsePrefixExpr();
 		break;
 	}
 	default: {
-		ret = nodePool.allocate(1);
+		ret = parserNewNode();
 		ret->type = NodeType::Error;
 		hasError = true;
 		return ret;
@@ -137,7 +149,7 @@ ExpressionNode* Parser::parserParsePrefixExpr() {
 	// 5(1 + 5), which means 5*(1+5)
 	// 5pi, which means 5*pi
 	if (curr.type == TokenType::Number || curr.type == TokenType::Ident || curr.type == TokenType::OpenParenthesis) {
-		ExpressionNode* new_ret = nodePool.allocate(1);
+		ExpressionNode* new_ret = parserNewNode();
 		new_ret->type = NodeType::Mul;
 		new_ret->binary.left = ret;
 		new_ret->binary.right = parserParseExpression(Precedence::Div);
@@ -147,7 +159,7 @@ ExpressionNode* Parser::parserParsePrefixExpr() {
 }
 
 ExpressionNode* Parser::parserParseInfixExpr(Token tk, ExpressionNode* left) {
-	ExpressionNode* ret = nodePool.allocate(1);
+	ExpressionNode* ret = parserNewNode();
 
 	switch (tk.type) {
 	case TokenType::Plus:
@@ -189,6 +201,10 @@ ExpressionNode* Parser::parserParseInfixExpr(Token tk, ExpressionNode* left) {
 }
 
 ExpressionNode* Parser::parserParseExpression(Precedence curr_operator_prec) {
+	if (memo != nullptr) {
+		return parserParseExpressionMemoized(curr_operator_prec);
+	}
+
 	ExpressionNode* left = parserParsePrefixExpr();
 	Token next_operator = curr;
 	Precedence next_operator_prec = getPrecedence(curr.type);
@@ -209,6 +225,134 @@ ExpressionNode* Parser::parserParseExpression(Precedence curr_operator_prec) {
 	return left;
 }
 
+// Same as parserParseExpression, but first tries to reuse the result of an earlier parse of the same tokens.
+// If that is not possible, it resumes the infix loop from the last checkpoint before the edited tokens.
+// The result only depends on the tokens from the start up to the token that ended it, so that is what
+// the memo entries cover.
+ExpressionNode* Parser::parserParseExpressionMemoized(Precedence curr_operator_prec) {
+	const size_t start = tokenIndex - 1; // index of curr
+
+	if (const ParseMemoEntry* result = memo->findResult(start, curr_operator_prec)) {
+		parserSeek(start + result->length);
+		hasError |= result->hadError;
+		return result->node;
+	}
+
+	// track the errors of this call on their own, so the memo entries know about them
+	const bool outerHasError = hasError;
+	hasError = false;
+
+	ExpressionNode* left = nullptr;
+	bool skipCheckpoint = false;
+	if (const ParseMemoEntry* checkpoint = memo->findCheckpoint(start, curr_operator_prec)) {
+		left = checkpoint->node;
+		hasError = checkpoint->hadError;
+		parserSeek(start + checkpoint->length);
+		skipCheckpoint = true; // it is already recorded
+	} else {
+		left = parserParsePrefixExpr();
+	}
+
+	Token next_operator = curr;
+	Precedence next_operator_prec = getPrecedence(curr.type);
+
+	while (next_operator_prec != Precedence::MIN && curr_operator_prec < next_operator_prec) {
+		const size_t operatorIndex = tokenIndex - 1;
+		if (!skipCheckpoint) {
+			memo->record(start, {left, static_cast<uint32_t>(operatorIndex - start), ParseMemo::noEntry,
+								 curr_operator_prec, true, hasError});
+		}
+		skipCheckpoint = false;
+
+		parserAdvance(); // Advance the operator
+
+		left = parserParseInfixExpr(next_operator, left);
+		next_operator = curr;
+		next_operator_prec = getPrecedence(curr.type);
+	}
+
+	const size_t end = tokenIndex - 1;
+	memo->record(start, {left, static_cast<uint32_t>(end - start), ParseMemo::noEntry, curr_operator_prec, false,
+						 hasError});
+	hasError |= outerHasError;
+	return left;
+}
+
+#pragma region parse memo
+
+void ParseMemo::clear() {
+	firstEntry.clear();
+	entries.clear();
+	reuseLimit = 0;
+}
+
+void ParseMemo::reset(size_t tokenCount) {
+	clear();
+	firstEntry.resize(tokenCount, TokenEntries{});
+}
+
+void ParseMemo::splice(size_t begin, size_t end, size_t insertedCount) {
+	assert(begin <= end && end <= firstEntry.size());
+	const size_t removedCount = end - begin;
+	if (insertedCount > removedCount) {
+		firstEntry.insert(firstEntry.begin() + end, insertedCount - removedCount, TokenEntries{});
+	} else if (insertedCount < removedCount) {
+		firstEntry.erase(firstEntry.begin() + begin + insertedCount, firstEntry.begin() + end);
+	}
+	std::fill(firstEntry.begin() + begin, firstEntry.begin() + begin + insertedCount, TokenEntries{});
+
+	// entries start on their first token, so only the ones starting before the edit can reach into it.
+	// An entry covers [token, token + length]
+	for (size_t token = 0; token < begin; token++) {
+		uint32_t* link = &firstEntry[token].results;
+		while (*link != noEntry) {
+			ParseMemoEntry& entry = entries[*link];
+			if (token + entry.length >= begin) {
+				*link = entry.next;
+			} else {
+				link = &entry.next;
+			}
+		}
+		// the checkpoints of a token are newest and therefore longest first, the ones that reach into the
+		// edit are always at the front
+		uint32_t& checkpoints = firstEntry[token].checkpoints;
+		while (checkpoints != noEntry && token + entries[checkpoints].length >= begin) {
+			checkpoints = entries[checkpoints].next;
+		}
+	}
+}
+
+const ParseMemoEntry* ParseMemo::findResult(size_t token, Precedence precedence) const {
+	for (uint32_t i = firstEntry[token].results; i != noEntry; i = entries[i].next) {
+		const ParseMemoEntry& entry = entries[i];
+		if (entry.precedence == precedence) {
+			return &entry;
+		}
+	}
+	return nullptr;
+}
+
+const ParseMemoEntry* ParseMemo::findCheckpoint(size_t callStart, Precedence precedence) const {
+	// the latest checkpoint before reuseLimit is the one that saves the most work. A call that resumes from a
+	// checkpoint only records the ones after it, so newer checkpoints of a call are always later ones
+	for (uint32_t i = firstEntry[callStart].checkpoints; i != noEntry; i = entries[i].next) {
+		const ParseMemoEntry& entry = entries[i];
+		if (entry.precedence == precedence && callStart + entry.length < reuseLimit) {
+			return &entry;
+		}
+	}
+	return nullptr;
+}
+
+void ParseMemo::record(size_t token, const ParseMemoEntry& entry) {
+	uint32_t& first = entry.isCheckpoint ? firstEntry[token].checkpoints : firstEntry[token].results;
+	entries.push_back(entry);
+	entries.back().next = first;
+	first = static_cast<uint32_t>(entries.size() - 1);
+}
+
+#pragma endregion
+
 void Parser::parserDebugDumpTree(ExpressionNode* node, size_t indent) {
 	for (size_t i = 0; i < indent; i++)
 		printf("  ");
@@ -266,8 +410,54 @@ void Parser::parserDebugDumpTree(ExpressionNode* node, size_t indent) {
 		parserDebugDumpTree(node->binary.right, indent + 1);
 	} break;
 	case NodeType::Function: {
-		printf("%.*s:\n", static_cast<int>(node->function.name.size()), node->function.name.data());
+		const std::string_view name = getBuiltinInfo(node->function.id).name;
+		printf("%.*s:\n", static_cast<int>(name.size()), name.data());
 		parserDebugDumpTree(node->function.argument, indent + 1);
 	}
 	}
-}
\ No newline at end of file
+}
+
+bool foldConstantTree(const ExpressionNode* node, double& value) {
+	double left, right;
+	switch (node->type) {
+	case NodeType::Number:
+		value = node->number;
+		return true;
+	case NodeType::Positive:
+		return foldConstantTree(node->unary.operand, value);
+	case NodeType::Negative:
+		if (!foldConstantTree(node->unary.operand, value)) {
+			return false;
+		}
+		value = -value;
+		return true;
+	case NodeType::Add:
+	case NodeType::Sub:
+	case NodeType::Mul:
+	case NodeType::Div:
+	case NodeType::Pow:
+		if (!foldConstantTree(node->binary.left, left) || !foldConstantTree(node->binary.right, right)) {
+			return false;
+		}
+		switch (node->type) {
+		case NodeType::Add:
+			value = left + right;
+			break;
+		case NodeType::Sub:
+			value = left - right;
+			break;
+		case NodeType::Mul:
+			value = left * right;
+			break;
+		case NodeType::Div:
+			value = left / right;
+			break;
+		default:
+			value = std::pow(left, right);
+			break;
+		}
+		return true;
+	default:
+		return false;
+	}
+}
@@ -0,0 +1,162 @@
+#include "chebyshevProxy.hpp"
+#include "intervalEval.hpp"
+#include "parser.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+#pragma region helperFunction
+
+static constexpr double pi = 3.14159265358979323846;
+// calls into libm an expression needs before the proxy pays for its fitting
+static constexpr size_t proxyMinCalls = 3;
+
+// cos(m pi / (2 DEGREE)), every angle the fitting needs is a multiple of this one
+static const std::array<double, 4 * ChebyshevProxy::DEGREE> angleCosines = []() {
+	std::array<double, 4 * ChebyshevProxy::DEGREE> cosines{};
+	for (int m = 0; m < 4 * ChebyshevProxy::DEGREE; m++) {
+		cosines[m] = std::cos(m * pi / (2 * ChebyshevProxy::DEGREE));
+	}
+	return cosines;
+}();
+
+// sum of coefficients[k] T_k(t)
+static inline double clenshaw(const double* coefficients, double t) {
+	double b1 = 0.0;
+	double b2 = 0.0;
+	for (int k = ChebyshevProxy::DEGREE; k >= 1; k--) {
+		const double b0 = coefficients[k] + 2.0 * t * b1 - b2;
+		b2 = b1;
+		b1 = b0;
+	}
+	return coefficients[0] + t * b1 - b2;
+}
+
+static size_t countLibraryCalls(const ExpressionNode* node) {
+	switch (node->type) {
+	case NodeType::Positive:
+	case NodeType::Negative:
+		return countLibraryCalls(node->unary.operand);
+	case NodeType::Pow:
+		// a number exponent is a few multiplications or one call, anything else is exp and log
+		return countLibraryCalls(node->binary.left) + countLibraryCalls(node->binary.right) +
+			   (node->binary.right->type == NodeType::Number ? 1 : 2);
+	case NodeType::Add:
+	case NodeType::Sub:
+	case NodeType::Mul:
+	case NodeType::Div:
+		return countLibraryCalls(node->binary.left) + countLibraryCalls(node->binary.right);
+	case NodeType::Function: {
+		const Builtin id = node->function.id;
+		// these are single instructions
+		const bool cheap = id == Builtin::Sqrt || id == Builtin::Fabs || id == Builtin::Floor ||
+						   id == Builtin::Ceil || id == Builtin::Round;
+		return countLibraryCalls(node->function.argument) + (cheap ? 0 : 1);
+	}
+	default:
+		return 0;
+	}
+}
+
+#pragma endregion
+#pragma region majorFunctions
+
+void ChebyshevProxy::fitPiece(calcFunction func, const IntervalFunction* bounds, double x0, double x1, int depth,
+							  double tolerance, ProxyStats& stats) {
+	const double mid = 0.5 * (x0 + x1);
+	const double half = 0.5 * (x1 - x0);
+	// a piece that does not fit is halved, the smallest ones are left to func
+	const auto reject = [&]() {
+		if (depth < MAX_DEPTH) {
+			fitPiece(func, bounds, x0, mid, depth + 1, tolerance, stats);
+			fitPiece(func, bounds, mid, x1, depth + 1, tolerance, stats);
+			return;
+		}
+		Piece& piece = pieces[pieceCount++];
+		piece.xMin = x0;
+		piece.xMax = x1;
+		piece.fitted = false;
+		stats.failedPieces++;
+	};
+
+	if (bounds != nullptr && !bounds->isEmpty()) {
+		const IntervalBounds range = bounds->evaluate(x0, x1);
+		stats.intervalEvaluations++;
+		if (range.partial || !range.slope.isBounded()) {
+			reject();
+			return;
+		}
+	}
+
+	Piece& piece = pieces[pieceCount];
+	piece.xMin = x0;
+	piece.xMax = x1;
+	piece.fitted = true;
+
+	// interpolates the values at the extrema of T_DEGREE, they include both ends, so neighbouring pieces meet
+	double values[DEGREE + 1];
+	for (int j = 0; j <= DEGREE; j++) {
+		values[j] = func(mid + half * angleCosines[2 * j]);
+		if (!std::isfinite(values[j])) {
+			stats.evaluations += j + 1;
+			reject();
+			return;
+		}
+	}
+	stats.evaluations += DEGREE + 1;
+	for (int k = 0; k <= DEGREE; k++) {
+		double sum = 0.5 * (values[0] + (k % 2 == 0 ? values[DEGREE] : -values[DEGREE]));
+		for (int j = 1; j < DEGREE; j++) {
+			sum += values[j] * angleCosines[(2 * k * j) % (4 * DEGREE)];
+		}
+		piece.coefficients[k] = (k == 0 || k == DEGREE ? 1.0 : 2.0) * sum / DEGREE;
+	}
+	// coefficients that have not decayed yet mean the curve has more detail than the degree holds
+	if (std::abs(piece.coefficients[DEGREE - 1]) + std::abs(piece.coefficients[DEGREE]) > tolerance) {
+		reject();
+		return;
+	}
+	for (int k = 0; k < DEGREE; k++) {
+		const double t = angleCosines[2 * k + 1];
+		const double y = func(mid + half * t);
+		stats.evaluations++;
+		if (!(std::abs(y - clenshaw(piece.coefficients, t)) <= tolerance)) {
+			reject();
+			return;
+		}
+	}
+	pieceCount++;
+	stats.pieces++;
+}
+
+ProxyStats ChebyshevProxy::fit(calcFunction func, const IntervalFunction* bounds, double xMin, double xMax,
+							   double tolerance) {
+	ProxyStats stats{};
+	pieceCount = 0;
+	if (func == nullptr || !(xMax > xMin)) {
+		return stats;
+	}
+	fitPiece(func, bounds, xMin, xMax, 0, tolerance, stats);
+	return stats;
+}
+
+bool ChebyshevProxy::evaluate(double x, double& y) const {
+	if (pieceCount == 0 || !(pieces[0].xMin <= x && x <= pieces[pieceCount - 1].xMax)) {
+		return false;
+	}
+	// the pieces are in order and without gaps
+	const Piece* piece =
+		std::partition_point(pieces, pieces + pieceCount - 1, [x](const Piece& p) { return p.xMax < x; });
+	if (!piece->fitted) {
+		return false;
+	}
+	const double t = (2.0 * x - (piece->xMin + piece->xMax)) / (piece->xMax - piece->xMin);
+	y = clenshaw(piece->coefficients, std::clamp(t, -1.0, 1.0));
+	return true;
+}
+
+bool isWorthProxying(const ExpressionNode* root) {
+	return root != nullptr && countLibraryCalls(root) >= proxyMinCalls;
+}
+
+#pragma endregion
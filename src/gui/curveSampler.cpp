@@ -0,0 +1,532 @@
+#include "curveSampler.hpp"
+#include "chebyshevProxy.hpp"
+#include "intervalEval.hpp"
+#include "tools.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#pragma region helperFunction
+
+// a half that still holds this much of the height of the whole segment is treated as holding a jump
+static constexpr double jumpKeepRatio = 0.75;
+// start segments that are tried to be proven flat or off screen at once with the interval bounds,
+// a failed proof costs one interval evaluation per span
+static constexpr size_t proofSpanSegments = 8;
+// segments are split this far around their middle, see splitPoint
+static constexpr double splitJitter = 0.1;
+// the most samples one leaf can emit, a pole stepped over is two edges with a break
+static constexpr size_t maxLeafSamples = 6;
+
+struct SamplerState {
+	calcFunction func;
+	const IntervalFunction* bounds;
+	const ChebyshevProxy* proxy;
+	const SampleView& view;
+	const SamplerSettings& settings;
+	SampleVector& out;
+	SampleStats stats;
+
+	// turn counting of the adaptive pass, direction is 0 until the first move after a break
+	bool countTurns = true;
+	size_t maxTurns = SIZE_MAX;
+	int direction = 0;
+	double extremeY = 0.0;
+	bool oscillating = false; // the adaptive pass gives up for the envelope
+	// ends of start segments that are still to come, refinement leaves room in the budget for them
+	size_t reservedSamples = 0;
+};
+
+// a fixed pseudo random number in [0, 1) for a and b, splitmix64
+static inline double hashUnit(uint64_t a, uint64_t b) {
+	uint64_t z = a * 0x9E3779B97F4A7C15ull + b * 0xBF58476D1CE4E5B9ull;
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+	z ^= z >> 31;
+	return static_cast<double>(z >> 11) * 0x1.0p-53;
+}
+
+// Where [x0, x1] is split, near but not exactly at the middle. Halving lands on a dyadic grid, and a
+// curve whose period is a multiple of its spacing aliases to a smooth wave that passes every flatness test
+// (sin(1000x) looks like a slow sine). A jitter that only depends on x0 keeps tiles reproducible.
+static inline double splitPoint(double x0, double x1) {
+	uint64_t bits;
+	memcpy(&bits, &x0, sizeof(bits));
+	const double t = 0.5 + splitJitter * (hashUnit(bits, 1) - 0.5);
+	return x0 + t * (x1 - x0);
+}
+
+static inline double evaluate(SamplerState& state, double x) {
+	double y;
+	if (state.proxy != nullptr && state.proxy->evaluate(x, y)) {
+		state.stats.proxyEvaluations++;
+		return y;
+	}
+	state.stats.evaluations++;
+	return state.func(x);
+}
+
+// a turn is counted once the curve went back by more than maxPixelError from its last extreme
+static inline void countTurn(SamplerState& state, double y) {
+	const double tolerance = state.settings.maxPixelError / state.view.pixelsPerUnitY;
+	if (state.out.empty() || isSampleBreak(state.out.back())) {
+		state.direction = 0;
+		state.extremeY = y;
+		return;
+	}
+	const double move = y - state.extremeY;
+	if (state.direction == 0) {
+		if (std::abs(move) > tolerance) {
+			state.direction = move > 0.0 ? 1 : -1;
+			state.extremeY = y;
+		}
+	} else if (move * state.direction >= 0.0) {
+		state.extremeY = y;
+	} else if (std::abs(move) > tolerance) {
+		state.direction = -state.direction;
+		state.extremeY = y;
+		state.oscillating = ++state.stats.turns > state.maxTurns;
+	}
+}
+
+// a non finite value ends the current strip, it is never drawn
+// true if count more samples fit into the budget next to the reserved ones
+static inline bool hasRoom(const SamplerState& state, size_t count) {
+	return state.out.size() + state.reservedSamples + count <= state.settings.sampleBudget;
+}
+
+// sampleBudget is a hard limit on the samples, a sample that does not fit anymore is dropped
+static inline void emit(SamplerState& state, double x, double y) {
+	if (state.out.size() >= state.settings.sampleBudget) {
+		return;
+	}
+	if (!std::isfinite(y)) {
+		if (!state.out.empty() && !isSampleBreak(state.out.back())) {
+			state.out.push_back(sampleBreak);
+			state.stats.breaks++;
+		}
+		return;
+	}
+	if (state.countTurns) {
+		countTurn(state, y);
+	}
+	const SampleView& view = state.view;
+	state.out.push_back({static_cast<float>((x - view.anchor.x) * view.outputScale),
+						 static_cast<float>((y - view.anchor.y) * view.outputScale)});
+}
+
+// false if there is no interval function
+static inline bool evaluateBounds(SamplerState& state, double x0, double x1, IntervalBounds& bounds) {
+	if (state.bounds == nullptr || state.bounds->isEmpty()) {
+		return false;
+	}
+	state.stats.intervalEvaluations++;
+	bounds = state.bounds->evaluate(x0, x1);
+	return true;
+}
+
+// the values over [x0, x1], tightened by the slope from the value at x0, the natural bounds of an expression
+// like x - x grow with the width while the slope form stays close
+static Interval valueBounds(const IntervalBounds& bounds, double x0, double y0, double x1) {
+	Interval value = bounds.value;
+	if (std::isfinite(y0) && bounds.slope.isBounded()) {
+		const double width = x1 - x0;
+		const double lo = y0 + std::min(bounds.slope.lo * width, 0.0);
+		const double hi = y0 + std::max(bounds.slope.hi * width, 0.0);
+		value.lo = std::max(value.lo, std::nextafter(std::nextafter(lo, -INFINITY), -INFINITY));
+		value.hi = std::min(value.hi, std::nextafter(std::nextafter(hi, INFINITY), INFINITY));
+	}
+	return value;
+}
+
+static inline bool isOffScreen(const SampleView& view, Interval value) {
+	return value.lo > view.yMax || value.hi < view.yMin;
+}
+
+// true if [x0, x1] needs no samples inside: it has no value anywhere, is off screen or is flat.
+// A slope in [m, M] keeps the curve within (M - m) w / 4 of its chord.
+static bool isSpanProven(SamplerState& state, double x0, double y0, double x1) {
+	IntervalBounds bounds;
+	if (!evaluateBounds(state, x0, x1, bounds)) {
+		return false;
+	}
+	if (bounds.value.isEmpty()) {
+		return true;
+	}
+	if (bounds.partial) {
+		return false; // singular somewhere, the edges are searched by subdivide
+	}
+	const SampleView& view = state.view;
+	const bool flat = bounds.slope.isBounded() && (bounds.slope.hi - bounds.slope.lo) * (x1 - x0) * 0.25 *
+														  view.pixelsPerUnitY <= state.settings.maxPixelError;
+	return flat || isOffScreen(view, valueBounds(bounds, x0, y0, x1));
+}
+
+// all three values on the same side outside of the view, nothing of the segment is visible
+static inline bool isOffScreen(const SampleView& view, double y0, double ym, double y1) {
+	return (y0 > view.yMax && ym > view.yMax && y1 > view.yMax) ||
+		   (y0 < view.yMin && ym < view.yMin && y1 < view.yMin);
+}
+
+// emits the samples of (x0, x1] where exactly one of y0 and y1 is finite,
+// bisects for the last finite point so the strip ends right at the edge of the NaN or infinite run
+static void emitNonFiniteEdge(SamplerState& state, double x0, double y0, double x1, double y1) {
+	const bool leftFinite = std::isfinite(y0);
+	double finiteX = leftFinite ? x0 : x1;
+	double finiteY = leftFinite ? y0 : y1;
+	double otherX = leftFinite ? x1 : x0;
+	for (int i = 0; i < state.settings.maxBisections; i++) {
+		const double xm = 0.5 * (finiteX + otherX);
+		const double ym = evaluate(state, xm);
+		if (std::isfinite(ym)) {
+			finiteX = xm;
+			finiteY = ym;
+		} else {
+			otherX = xm;
+		}
+	}
+	if (leftFinite) {
+		emit(state, finiteX, finiteY);
+		emit(state, x1, y1);
+	} else {
+		emit(state, x0, y0); // the break
+		emit(state, finiteX, finiteY);
+		emit(state, x1, y1);
+	}
+}
+
+// emits the samples of (x0, x1] for a segment that is still too far from its chord but may not be split anymore.
+// A jump keeps all of its height in one half however often it is halved, a steep continuous curve halves it
+// in a few steps. Jumps get a break instead of a vertical line.
+static void emitLeaf(SamplerState& state, double x0, double y0, double x1, double y1) {
+	const double ppuY = state.view.pixelsPerUnitY;
+	if (std::abs(y1 - y0) * ppuY <= state.settings.jumpPixels || !hasRoom(state, maxLeafSamples)) {
+		emit(state, x1, y1);
+		return;
+	}
+
+	// a bounded slope means there is no jump, however steep the segment is
+	IntervalBounds bounds;
+	if (evaluateBounds(state, x0, x1, bounds) && !bounds.partial && bounds.slope.isBounded()) {
+		emit(state, x1, y1);
+		return;
+	}
+
+	double a = x0, ya = y0;
+	double b = x1, yb = y1;
+	for (int i = 0; i < state.settings.maxBisections; i++) {
+		const double xm = 0.5 * (a + b);
+		const double ym = evaluate(state, xm);
+		if (!std::isfinite(ym)) {
+			// a pole that was stepped over, like tan between two finite samples
+			emitNonFiniteEdge(state, x0, y0, xm, ym);
+			emitNonFiniteEdge(state, xm, ym, x1, y1);
+			return;
+		}
+		const double left = std::abs(ym - ya);
+		const double right = std::abs(yb - ym);
+		const double height = std::abs(yb - ya);
+		if (std::max(left, right) < jumpKeepRatio * height) {
+			emit(state, x1, y1); // continuous, the height went down with the width
+			return;
+		}
+		if (left >= right) {
+			b = xm;
+			yb = ym;
+		} else {
+			a = xm;
+			ya = ym;
+		}
+	}
+	if (std::abs(yb - ya) * ppuY <= state.settings.jumpPixels) {
+		emit(state, x1, y1);
+		return;
+	}
+	if (a != x0) {
+		emit(state, a, ya);
+	}
+	emit(state, b, NAN);
+	emit(state, b, yb);
+	if (b != x1) {
+		emit(state, x1, y1);
+	}
+}
+
+// emits the samples of (x0, x1], the caller has already emitted x0
+static void subdivide(SamplerState& state, double x0, double y0, double x1, double y1, int depth,
+					  size_t& budget) {
+	const SampleView& view = state.view;
+	const SamplerSettings& settings = state.settings;
+	if (state.oscillating) {
+		return; // the samples are thrown away for the envelope
+	}
+
+	const bool finite0 = std::isfinite(y0);
+	const bool finite1 = std::isfinite(y1);
+	if (finite0 != finite1) {
+		// bisection finds the edge with a bounded number of evaluations instead of recursing down to it
+		if (hasRoom(state, maxLeafSamples)) {
+			emitNonFiniteEdge(state, x0, y0, x1, y1);
+		} else {
+			emit(state, x1, y1);
+		}
+		return;
+	}
+
+	// a split emits at least one more sample and a leaf after it at most maxLeafSamples,
+	// the right halves still to come on the way up need one sample each
+	if (depth >= settings.maxDepth || budget == 0 || !hasRoom(state, maxLeafSamples + 1 + depth) ||
+		(x1 - x0) * view.pixelsPerUnitX < settings.minSegmentPixels) {
+		if (finite0) {
+			emitLeaf(state, x0, y0, x1, y1);
+		} else {
+			emit(state, x1, y1);
+		}
+		return;
+	}
+
+	// with bounds a NaN run is searched for finite islands until they prove there are none
+	bool mayHaveValue = false;
+	if (!finite0) {
+		IntervalBounds bounds;
+		if (evaluateBounds(state, x0, x1, bounds)) {
+			if (bounds.value.isEmpty()) {
+				emit(state, x1, y1);
+				return;
+			}
+			mayHaveValue = true;
+		}
+	}
+
+	const double xm = splitPoint(x0, x1);
+	const double ym = evaluate(state, xm);
+	budget--;
+
+	bool split;
+	if (!finite0) {
+		// both ends are in a NaN or infinite run, split only if there is something finite in between
+		split = mayHaveValue || std::isfinite(ym);
+	} else if (!std::isfinite(ym)) {
+		split = true;
+	} else if (isOffScreen(view, y0, ym, y1)) {
+		// three samples can miss a narrow peak, the bounds can prove there is none
+		IntervalBounds bounds;
+		split = evaluateBounds(state, x0, x1, bounds) && !isOffScreen(view, valueBounds(bounds, x0, y0, x1));
+	} else {
+		// flatness test, how far the curve is from the straight line that would be drawn
+		const double chord = y0 + (xm - x0) / (x1 - x0) * (y1 - y0);
+		const double chordError = std::abs(ym - chord) * view.pixelsPerUnitY;
+		split = chordError > settings.maxPixelError;
+	}
+
+	if (!split) {
+		// the midpoint is within the error of the chord, dropping it saves a vertex
+		emit(state, x1, y1);
+		return;
+	}
+	subdivide(state, x0, y0, xm, ym, depth + 1, budget);
+	subdivide(state, xm, ym, x1, y1, depth + 1, budget);
+}
+
+// the min and max of every pixel column as a vertical span, the spans are joined in a zigzag
+// (min, max of one column then max, min of the next) so the joins stay inside of the envelope.
+// Neighbouring columns share the sample at their edge, so the spans of a continuous curve overlap.
+static void sampleEnvelope(SamplerState& state, size_t columns) {
+	const SampleView& view = state.view;
+	const int interior = std::max(state.settings.envelopeSamplesPerColumn - 1, 1);
+	const double columnWidth = (view.xMax - view.xMin) / columns;
+	// the column index in the world keeps the jitter of a column the same whatever part of the curve is sampled
+	const int64_t firstColumn = static_cast<int64_t>(std::floor(view.xMin / columnWidth));
+
+	double edgeY = evaluate(state, view.xMin);
+	for (size_t column = 0; column < columns; column++) {
+		const double x0 = view.xMin + column * columnWidth;
+		const double nextEdgeY = evaluate(state, column + 1 == columns ? view.xMax : x0 + columnWidth);
+		double low = INFINITY;
+		double high = -INFINITY;
+		const auto include = [&](double y) {
+			if (std::isfinite(y)) {
+				low = std::min(low, y);
+				high = std::max(high, y);
+			}
+		};
+		include(edgeY);
+		include(nextEdgeY);
+		for (int i = 0; i < interior; i++) {
+			const double jitter = hashUnit(static_cast<uint64_t>(firstColumn + column), i);
+			include(evaluate(state, x0 + columnWidth * (i + jitter) / interior));
+		}
+		edgeY = nextEdgeY;
+
+		const double x = x0 + 0.5 * columnWidth;
+		if (!(low <= high)) {
+			emit(state, x, NAN); // nothing finite in the column
+			continue;
+		}
+		const bool upwards = (column & 1) == 0;
+		emit(state, x, upwards ? low : high);
+		emit(state, x, upwards ? high : low);
+	}
+}
+
+#pragma endregion
+#pragma region majorFunctions
+
+SampleStats sampleCurve(calcFunction func, const IntervalFunction* bounds, const ChebyshevProxy* proxy,
+						const SampleView& view, const SamplerSettings& settings, SampleVector& out) {
+	out.clear();
+	if (func == nullptr || !(view.xMax > view.xMin)) {
+		return {};
+	}
+
+	SamplerState state{func, bounds, proxy, view, settings, out, {}};
+
+	const double widthPixels = (view.xMax - view.xMin) * view.pixelsPerUnitX;
+	state.maxTurns = static_cast<size_t>(settings.envelopeTurnsPerPixel * widthPixels);
+	const size_t segments = std::clamp(static_cast<size_t>(std::ceil(widthPixels / settings.initialSegmentPixels)),
+									   size_t(1), std::max(settings.sampleBudget / 2, size_t(1)));
+	// the budget left for refinement is shared out evenly, so a costly start cannot starve the end of the curve
+	size_t refineBudget = settings.sampleBudget > segments + 1 ? settings.sampleBudget - segments - 1 : 0;
+	out.reserve(std::min(settings.sampleBudget, 4 * segments + 1));
+
+	const double step = (view.xMax - view.xMin) / segments;
+	const auto segmentEnd = [&](size_t i) { return i + 1 == segments ? view.xMax : view.xMin + (i + 1) * step; };
+	double x0 = view.xMin;
+	double y0 = evaluate(state, x0);
+	emit(state, x0, y0);
+	for (size_t i = 0; i < segments && !state.oscillating;) {
+		// a span the bounds prove to need nothing inside is skipped with the samples of its start segments
+		const size_t span = std::min(proofSpanSegments, segments - i);
+		state.reservedSamples = segments - i - 1;
+		if (span > 1 && isSpanProven(state, x0, y0, segmentEnd(i + span - 1))) {
+			x0 = segmentEnd(i + span - 1);
+			y0 = evaluate(state, x0);
+			emit(state, x0, y0);
+			i += span;
+			continue;
+		}
+
+		for (const size_t end = i + span; i < end; i++) {
+			const double x1 = segmentEnd(i);
+			const double y1 = evaluate(state, x1);
+
+			state.reservedSamples = segments - i - 1;
+			size_t budget = refineBudget / (segments - i);
+			refineBudget -= budget;
+			subdivide(state, x0, y0, x1, y1, 0, budget);
+			refineBudget += budget; // what this segment did not need
+			if (state.oscillating) {
+				break;
+			}
+
+			x0 = x1;
+			y0 = y1;
+		}
+	}
+
+	if (state.oscillating) {
+		// the budget is still the limit, two samples per column
+		const size_t columns = std::clamp(static_cast<size_t>(std::ceil(widthPixels)), size_t(1),
+										  std::max(settings.sampleBudget / 2, size_t(1)));
+		out.clear();
+		state.reservedSamples = 0;
+		state.countTurns = false;
+		state.stats.breaks = 0;
+		state.stats.envelope = true;
+		sampleEnvelope(state, columns);
+	}
+
+	state.stats.samples = out.size();
+	return state.stats;
+}
+
+size_t findSampleStrips(const glm::vec2* samples, size_t count, int32_t* firsts, int32_t* counts) {
+	size_t strips = 0;
+	size_t first = 0;
+	for (size_t i = 0; i <= count; i++) {
+		if (i != count && !isSampleBreak(samples[i])) {
+			continue;
+		}
+		// a single sample between two breaks has no line to draw
+		if (i - first >= 2) {
+			firsts[strips] = static_cast<int32_t>(first);
+			counts[strips] = static_cast<int32_t>(i - first);
+			strips++;
+		}
+		first = i + 1;
+	}
+	return strips;
+}
+
+#pragma endregion
+#pragma region debug
+
+// the sampler generateGraphData used before, a step of 2 / (100 * sqrt(scale)) in NDC
+// refined 10 times wherever y changed by more than 0.01 world units
+static SampleStats legacySampleCurve(calcFunction func, float scale, glm::vec2 origin) {
+	SampleStats stats{};
+	const size_t targetNumPoints = static_cast<size_t>(100.0f / std::sqrt(scale));
+	const float step = 2.0f / targetNumPoints;
+	float prevX = -1.0f;
+	float prevY = func(prevX / scale + origin.x);
+	stats.evaluations++;
+	for (size_t j = 0; j <= targetNumPoints; ++j) {
+		const float normalizedX = -1.0f + j * step;
+		const float y = func((normalizedX / scale) + origin.x);
+		stats.evaluations++;
+		if (std::abs(y - prevY) > 0.01f) {
+			const float refinedStep = step / 10.0f;
+			for (float refinedX = prevX + refinedStep; refinedX < normalizedX; refinedX += refinedStep) {
+				func((refinedX / scale) + origin.x);
+				stats.evaluations++;
+				stats.samples++;
+			}
+		}
+		stats.samples++;
+		prevX = normalizedX;
+		prevY = y;
+	}
+	return stats;
+}
+
+void curveSamplerDebugBenchmark(int framebufferWidth, int framebufferHeight) {
+	struct TestCurve {
+		const char* name;
+		calcFunction func;
+	};
+	static const TestCurve curves[] = {
+		{"x", [](double x) { return x; }},
+		{"x*x", [](double x) { return x * x; }},
+		{"sin(x)", [](double x) { return std::sin(x); }},
+		{"sin(10x)", [](double x) { return std::sin(10.0 * x); }},
+		{"sin(1000x)", [](double x) { return std::sin(1000.0 * x); }},
+		{"exp(x)", [](double x) { return std::exp(x); }},
+		{"100x^3", [](double x) { return 100.0 * x * x * x; }},
+		{"tan(x)", [](double x) { return std::tan(x); }},
+		{"1/x", [](double x) { return 1.0 / x; }},
+	};
+	static constexpr float scales[] = {0.01f, 0.1f, 1.0f, 10.0f};
+
+	ArenaScope scope;
+	SampleVector samples;
+	const SamplerSettings settings{};
+	for (const TestCurve& curve : curves) {
+		for (const float scale : scales) {
+			SampleView view;
+			view.xMin = -1.0 / scale;
+			view.xMax = 1.0 / scale;
+			view.yMin = -1.0 / scale;
+			view.yMax = 1.0 / scale;
+			view.pixelsPerUnitX = 0.5 * framebufferWidth * scale;
+			view.pixelsPerUnitY = 0.5 * framebufferHeight * scale;
+			view.outputScale = scale;
+
+			const SampleStats before = legacySampleCurve(curve.func, scale, {0.0f, 0.0f});
+			const SampleStats after = sampleCurve(curve.func, nullptr, nullptr, view, settings, samples);
+			ilog(curve.name, "scale", scale, "samples", before.samples, "->", after.samples, "evaluations",
+				 before.evaluations, "->", after.evaluations);
+		}
+	}
+}
+
+#pragma endregion
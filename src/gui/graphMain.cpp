@@ -1,5 +1,11 @@
+#include "allocationCounter.hpp"
 #include "arenaAllocator.hpp"
+#include "chebyshevProxy.hpp"
+#include "curveSampler.hpp"
+#include "expressionSymmetry.hpp"
 #include "graphMain.hpp"
+#include "incrementalParser.hpp"
+#include "intervalEval.hpp"
 #include "JITcompiler.hpp"
 #include "mainGui.hpp"
 #include "parser.hpp"
@@ -14,6 +20,9 @@
 #include <random>
 #include <vector>
 #include <glm/gtc/type_ptr.hpp>
+#include "sampleScheduler.hpp"
+#include "samplerPool.hpp"
+#include "tileCache.hpp"
 #include "vboAllocator.hpp"
 #include "tools.hpp"
 
@@ -24,11 +33,48 @@ struct GLBufferInfo {
 	size_t amount = 0;
 };
 
+// the view a buffer was generated for, its vertices are in world space relative to anchor
+struct SampledRange {
+	glm::dvec2 anchor = {0.0, 0.0};
+	double xMin = 0.0;
+	double xMax = 0.0;
+	double yMin = 0.0;
+	double yMax = 0.0;
+	float scale = 0.0f; // 0 until the first generation
+};
+
 struct GraphEquation {
 	std::string input = "";
+	IncrementalParser parser;
 	CompiledFunction func{};
+	IntervalFunction bounds; // the same expression in interval arithmetic, empty if there is none
+	ExpressionSymmetry symmetry{};
+	bool proxied = false; // expensive enough to be sampled from a Chebyshev proxy
 	GLBufferInfo vboObj;
+	GLuint vao = 0;
+	SampledRange sampled{};
 	glm::vec3 color = {0.0f, 0.0f, 0.0f};
+
+	// the samples outlive the frame, so they live in an arena of their own instead of global_arena
+	ArenaPtr arena = makeArena();
+	TileCache tileCache{arena.get()};
+	// line strips of the samples in vboObj, drawn with one glMultiDrawArrays. In arena as well and only
+	// grown, so uploading a result does not allocate
+	ArenaVector<GLint> stripFirsts{arena.get()};
+	ArenaVector<GLsizei> stripCounts{arena.get()};
+
+	// sampling runs on samplerPool, a result is only uploaded if no newer request was made since
+	uint64_t generation = 0;
+	bool jobInFlight = false; // tileCache belongs to the job until its result is collected
+	bool resamplePending = false;
+
+	// state of the coarse to fine passes of sampleScheduler
+	float pixelError = INFINITY; // of the buffer drawn now
+	bool visible = true;
+	float jobMs = 0.5f; // recent time of a job, the estimate for the next one
+	size_t sampledVertices = 0; // before clipping and simplification, vboObj.amount is after
+	size_t envelopeTiles = 0;	// drawn as min/max columns
+	size_t proxyEvaluations = 0;
 };
 
 #pragma endregion
@@ -40,15 +86,19 @@ static constexpr float goldenAngle = 137.50776405f;
 static constexpr float mouseSensitivity = 60;
 static constexpr float scrollSensitivity = 30;
 
-static constexpr float initialNumPoints = 100;
-static constexpr float graphThreshold = 0.01f;
+// buffers are generated for this many views more on every side than is visible
+static constexpr double viewMarginViews = 1.0;
+// and generated again once the zoom changed by more than this factor
+static constexpr float resampleZoomFactor = 2.0f;
 #pragma endregion
 #pragma region shader source
 static const char* const vertexShaderSource =
 	"#version 330 core\n"
-	"layout(location = 0) in vec2 position;\n"
+	"layout(location = 0) in vec2 position; // world space, relative to the anchor of the buffer\n"
+	"uniform vec2 viewOffset; // anchor of the buffer minus the center of the view\n"
+	"uniform vec2 viewScale;\n"
 	"void main() {\n"
-	"    gl_Position = vec4(position, 0.0, 1.0);\n"
+	"    gl_Position = vec4((position + viewOffset) * viewScale, 0.0, 1.0);\n"
 	"}\n";
 static const char* const geometryShaderSource =
 	"#version 330 core\n"
@@ -82,107 +132,125 @@ static const char* const fragmentShaderSource =
 #pragma region globals
 static GLint lineThicknessUniform = 0;
 static GLint lineColorUniform = 0;
+static GLint viewOffsetUniform = 0;
+static GLint viewScaleUniform = 0;
 static GLuint shaderProgram = 0;
 
 static std::array<GLBufferInfo, 3> gridVaos{};
 static GLuint gridVbo = 0;
+static SampledRange gridRange{};
+static double gridSpacing = 0.0;
 
 static std::vector<GraphEquation> graphEquations{};
 
 static VBOAllocator vboAllocator{};
+static SamplerPool samplerPool{};
+static SampleScheduler sampleScheduler{};
+
+// how quickly global_arena gives memory back after a spike like a deep zoom
+static ArenaTrimPolicy frameArenaTrimPolicy{};
 
 // use std::vector to allow dynamic amount of equations
 static glm::vec2 origin = {0, 0};
 static float scale = 1;
+// the sampler measures its error in pixels, updated at the start of every frame
+static glm::ivec2 framebufferSize = {1280, 720};
+static SamplerSettings samplerSettings{};
+// orders the cached tiles by when they were last drawn
+static uint64_t frameIndex = 0;
 
 #pragma endregion
 #pragma region generate VBOS
 
-void generateAxisData() {
-	constexpr auto roundToNearestPowerOf2 = [](float value) { return std::pow(2, std::round(std::log2(value))); };
-	constexpr int desiredLines = 65;
-
-	// Set screen-space boundaries in NDC (-1 to 1)
-	constexpr float screenMinX = -1.0f;
-	constexpr float screenMaxX = 1.0f;
-	constexpr float screenMinY = -1.0f;
-	constexpr float screenMaxY = 1.0f;
+// the world point in the middle of the screen, origin.y has the opposite sign of the world y it shows
+glm::dvec2 getViewCenter() {
+	return {origin.x, -origin.y};
+}
 
-	// Convert NDC to function space, factoring in origin and scale
-	const float worldMinX = origin.x + screenMinX / scale;
-	const float worldMaxX = origin.x + screenMaxX / scale;
-	const float worldMinY = origin.y + screenMinY / scale;
-	const float worldMaxY = origin.y + screenMaxY / scale;
+static double getGridSpacing() {
+	constexpr int desiredLines = 65;
+	return std::exp2(std::round(std::log2(2.0 / scale / desiredLines)));
+}
 
-	// Calculate the width and height in world space
-	const float size = 2 / scale;
-	// Calculate world spacing based on the number of lines
-	const float worldSpacing = roundToNearestPowerOf2(size / desiredLines);
-	const float invWorldSpacing = 1.0f / worldSpacing;
+void generateAxisData() {
+	// the vertices are only needed until they are uploaded
+	ArenaScope scope;
+	ArenaTag tag("grid");
+
+	// one view of margin on every side, so panning does not need new lines for a while
+	const glm::dvec2 center = getViewCenter();
+	const double halfExtent = (1.0 + 2.0 * viewMarginViews) / scale;
+	const double worldSpacing = getGridSpacing();
+
+	gridRange.anchor = center;
+	gridRange.xMin = center.x - halfExtent;
+	gridRange.xMax = center.x + halfExtent;
+	gridRange.yMin = center.y - halfExtent;
+	gridRange.yMax = center.y + halfExtent;
+	gridRange.scale = scale;
+	gridSpacing = worldSpacing;
+
+	// lines are in world space relative to the anchor, the vertex shader applies the view
+	const float minX = static_cast<float>(gridRange.xMin - center.x);
+	const float maxX = static_cast<float>(gridRange.xMax - center.x);
+	const float minY = static_cast<float>(gridRange.yMin - center.y);
+	const float maxY = static_cast<float>(gridRange.yMax - center.y);
 
 	// Ensure grid aligns with the real origin (0, 0)
-	float xStart = std::floor(worldMinX * invWorldSpacing) * worldSpacing;
-	float yStart = std::floor(worldMinY * invWorldSpacing) * worldSpacing;
-
-	// ensure in NDC range of [-1, 1]
-	if (xStart < -1.0f) {
-		xStart += worldSpacing;
-	}
-	if (yStart < -1.0f) {
-		yStart += worldSpacing;
-	}
+	const int64_t xFirst = static_cast<int64_t>(std::ceil(gridRange.xMin / worldSpacing));
+	const int64_t xLast = static_cast<int64_t>(std::floor(gridRange.xMax / worldSpacing));
+	const int64_t yFirst = static_cast<int64_t>(std::ceil(gridRange.yMin / worldSpacing));
+	const int64_t yLast = static_cast<int64_t>(std::floor(gridRange.yMax / worldSpacing));
 
 	std::vector<float, ArenaAllocator<float>> verticesThin;
 	std::vector<float, ArenaAllocator<float>> verticesMedium;
 	std::array<float, 8> verticesThick{};
 
-	verticesMedium.reserve(desiredLines * 0.2 * 2 + 2);
-	verticesThin.reserve(desiredLines * 0.8 * 2 + 2);
+	const size_t lineCount = static_cast<size_t>((xLast - xFirst + 1) + (yLast - yFirst + 1));
+	verticesMedium.reserve(lineCount / 4 * 4 + 8);
+	verticesThin.reserve(lineCount * 4);
 
 	// Generate vertical lines in world space
-
-	for (float x = xStart; x <= worldMaxX; x += worldSpacing) {
-		// Convert from function space to NDC
-		float ndcX = (x - origin.x) * scale;
-
-		if (x == 0) {
-			verticesThick[0] = ndcX;
-			verticesThick[1] = screenMinY;
-			verticesThick[2] = ndcX;
-			verticesThick[3] = screenMaxY;
-		} else if (static_cast<int>(x * invWorldSpacing) % 4 != 0) {
-			verticesThin.push_back(ndcX);		// x1
-			verticesThin.push_back(screenMinY); // y1
-			verticesThin.push_back(ndcX);		// x2
-			verticesThin.push_back(screenMaxY); // y2
+	for (int64_t i = xFirst; i <= xLast; i++) {
+		const float x = static_cast<float>(i * worldSpacing - center.x);
+
+		if (i == 0) {
+			verticesThick[0] = x;
+			verticesThick[1] = minY;
+			verticesThick[2] = x;
+			verticesThick[3] = maxY;
+		} else if (i % 4 != 0) {
+			verticesThin.push_back(x);	  // x1
+			verticesThin.push_back(minY); // y1
+			verticesThin.push_back(x);	  // x2
+			verticesThin.push_back(maxY); // y2
 		} else {
-			verticesMedium.push_back(ndcX);		  // x1
-			verticesMedium.push_back(screenMinY); // y1
-			verticesMedium.push_back(ndcX);		  // x2
-			verticesMedium.push_back(screenMaxY); // y2
+			verticesMedium.push_back(x);	// x1
+			verticesMedium.push_back(minY); // y1
+			verticesMedium.push_back(x);	// x2
+			verticesMedium.push_back(maxY); // y2
 		}
 	}
 
 	// Generate horizontal lines in world space
-	for (float y = yStart; y <= worldMaxY; y += worldSpacing) {
-		// Correctly calculate ndcY using the origin and scale
-		float ndcY = (-y + origin.y) * scale; // Use the original y value and adjust correctly
-
-		if (y == 0) {
-			verticesThick[4] = screenMinX;
-			verticesThick[5] = ndcY;
-			verticesThick[6] = screenMaxX;
-			verticesThick[7] = ndcY;
-		} else if (static_cast<int>(y * invWorldSpacing) % 4 != 0) {
-			verticesThin.push_back(screenMinX); // x1
-			verticesThin.push_back(ndcY);		// y1
-			verticesThin.push_back(screenMaxX); // x2
-			verticesThin.push_back(ndcY);		// y2
+	for (int64_t i = yFirst; i <= yLast; i++) {
+		const float y = static_cast<float>(i * worldSpacing - center.y);
+
+		if (i == 0) {
+			verticesThick[4] = minX;
+			verticesThick[5] = y;
+			verticesThick[6] = maxX;
+			verticesThick[7] = y;
+		} else if (i % 4 != 0) {
+			verticesThin.push_back(minX); // x1
+			verticesThin.push_back(y);	  // y1
+			verticesThin.push_back(maxX); // x2
+			verticesThin.push_back(y);	  // y2
 		} else {
-			verticesMedium.push_back(screenMinX); // x1
-			verticesMedium.push_back(ndcY);		  // y1
-			verticesMedium.push_back(screenMaxX); // x2
-			verticesMedium.push_back(ndcY);		  // y2
+			verticesMedium.push_back(minX); // x1
+			verticesMedium.push_back(y);	// y1
+			verticesMedium.push_back(maxX); // x2
+			verticesMedium.push_back(y);	// y2
 		}
 	}
 
@@ -225,6 +293,23 @@ void generateAxisData() {
 	glBindVertexArray(0);
 }
 
+// the view transform of a buffer sampled for range, the vertex shader does the rest
+static void setViewUniforms(const SampledRange& range) {
+	const glm::dvec2 offset = range.anchor - getViewCenter();
+	glUniform2f(viewOffsetUniform, static_cast<float>(offset.x), static_cast<float>(offset.y));
+	glUniform2f(viewScaleUniform, scale, scale);
+}
+
+// whether a buffer sampled for range can still be drawn by only moving it in the vertex shader
+static bool coversView(const SampledRange& range) {
+	const glm::dvec2 center = getViewCenter();
+	const double halfExtent = 1.0 / scale;
+	const float zoom = scale / range.scale;
+	return range.scale != 0.0f && zoom <= resampleZoomFactor && zoom >= 1.0f / resampleZoomFactor &&
+		   range.xMin <= center.x - halfExtent && center.x + halfExtent <= range.xMax &&
+		   range.yMin <= center.y - halfExtent && center.y + halfExtent <= range.yMax;
+}
+
 void clearGraphData(GLBufferInfo& vboObject) {
 	// for the case where you created an empty graph and immediatly removed it
 	if (vboObject.id != 0) {
@@ -234,55 +319,123 @@ void clearGraphData(GLBufferInfo& vboObject) {
 	vboObject.amount = 0;
 }
 
-void generateGraphData(const CompiledFunction& func, GLBufferInfo& vboObject,
-					   std::vector<glm::vec2, ArenaAllocator<glm::vec2>>& vertexData) {
-	if (func == nullptr) {
-		return;
-	}
-	size_t targetNumPoints = static_cast<size_t>(initialNumPoints / std::sqrt(scale));
-	vertexData.reserve(targetNumPoints);
-	vertexData.clear();
-
-	float step = 2.0f / targetNumPoints;
-
-	float prevX = -1.0f;
-	float prevY = func(prevX / scale + origin.x);
+// the visible part of the world widened by margin views on the left and right,
+// samples are written in world space relative to the center of the view
+SampleView makeSampleView(double margin) {
+	const glm::dvec2 center = getViewCenter();
+	const double halfExtent = 1.0 / scale;
+	SampleView view;
+	view.xMin = center.x - (1.0 + 2.0 * margin) * halfExtent;
+	view.xMax = center.x + (1.0 + 2.0 * margin) * halfExtent;
+	view.yMin = center.y - halfExtent;
+	view.yMax = center.y + halfExtent;
+	view.pixelsPerUnitX = 0.5 * framebufferSize.x * scale;
+	view.pixelsPerUnitY = 0.5 * framebufferSize.y * scale;
+	view.anchor = center;
+	view.outputScale = 1.0;
+	return view;
+}
 
-	for (int j = 0; j <= targetNumPoints; ++j) {
-		float normalizedX = -1.0f + j * step;
-		float x = (normalizedX / scale) + origin.x;
+// the buffer of graph is sampled again on a worker, the old one is drawn until the result is uploaded
+void requestGraphData(GraphEquation& graph) {
+	graph.generation++;
+	graph.resamplePending = true;
+}
 
-		float y = func(x);
+// how far the buffer of graph is off on screen, infinite if it does not cover the view
+static float getScreenError(const GraphEquation& graph) {
+	if (!coversView(graph.sampled)) {
+		return INFINITY;
+	}
+	return graph.pixelError * scale / graph.sampled.scale;
+}
 
-		float deltaY = std::abs(y - prevY);
+static void submitGraphJob(GraphEquation& graph, float screenError) {
+	SampleJob job;
+	job.owner = &graph;
+	job.generation = graph.generation;
+	job.cache = &graph.tileCache;
+	job.func = graph.func.getFunction();
+	job.bounds = &graph.bounds;
+	job.symmetry = graph.symmetry;
+	// only the tiles that were not on screen before are sampled
+	job.view = makeSampleView(viewMarginViews);
+	job.settings = sampleScheduler.nextPass(samplerSettings, screenError);
+	job.settings.chebyshevProxy = graph.proxied;
+	job.frame = frameIndex;
+
+	graph.resamplePending = false;
+	graph.jobInFlight = true;
+	samplerPool.submit(job);
+}
 
-		// If deltaY is large, reduce the step size to add more points for better precision
-		if (deltaY > graphThreshold) {
-			float refinedStep = step / 10.0f;
-			for (float refinedX = prevX + refinedStep; refinedX < normalizedX; refinedX += refinedStep) {
-				float refinedFuncX = (refinedX / scale) + origin.x;
-				float refinedY = func(refinedFuncX);
-				float refinedScaledY = (refinedY + origin.y) * scale;
-				vertexData.push_back({refinedX, refinedScaledY});
-			}
+// submits the jobs that fit into the sampling budget of this frame, the rest waits for the next frames
+static void scheduleGraphJobs() {
+	ArenaScope scope;
+	std::vector<ScheduleCandidate, ArenaAllocator<ScheduleCandidate>> candidates;
+	candidates.reserve(graphEquations.size());
+	for (size_t i = 0; i < graphEquations.size(); i++) {
+		const GraphEquation& graph = graphEquations[i];
+		if (graph.jobInFlight || graph.func == nullptr) {
+			continue;
+		}
+		const float screenError = getScreenError(graph);
+		if (!graph.resamplePending && screenError <= samplerSettings.maxPixelError) {
+			continue;
 		}
+		candidates.push_back({i, graph.visible, screenError, graph.jobMs});
+	}
 
-		float scaledY = (y + origin.y) * scale;
-		vertexData.push_back({normalizedX, scaledY});
+	const size_t planned = sampleScheduler.plan(candidates.data(), candidates.size(), samplerPool.getThreadCount());
+	for (size_t i = 0; i < planned; i++) {
+		submitGraphJob(graphEquations[candidates[i].index], candidates[i].screenError);
+	}
+	sampleScheduler.endFrame();
+}
 
-		prevX = normalizedX;
-		prevY = y;
+static void uploadGraphData(SampleResult& result) {
+	GraphEquation& graph = *static_cast<GraphEquation*>(result.owner);
+	graph.jobInFlight = false;
+	graph.jobMs = 0.7f * graph.jobMs + 0.3f * result.milliseconds;
+	sampleScheduler.recordFinished(result.milliseconds);
+	if (result.samples == nullptr) {
+		graph.resamplePending = true;
+		return;
 	}
 
-	glBindBuffer(GL_ARRAY_BUFFER, vboObject.id);
-	vboObject.amount = vertexData.size();
-	glBufferData(GL_ARRAY_BUFFER, vertexData.size() * sizeof(glm::vec2), vertexData.data(), GL_STATIC_DRAW);
-}
+	SampledRange range;
+	range.anchor = result.view.anchor;
+	range.xMin = result.view.xMin;
+	range.xMax = result.view.xMax;
+	range.yMin = result.stats.yMin;
+	range.yMax = result.stats.yMax;
+	range.scale = static_cast<float>(2.0 / (result.view.yMax - result.view.yMin));
+
+	// a result of an older request is still good while it covers the view, otherwise it is dropped
+	if (result.generation != graph.generation) {
+		if (!coversView(range)) {
+			return;
+		}
+		graph.resamplePending = false;
+	}
 
+	graph.sampled = range;
+	graph.pixelError = result.stats.pixelError;
+	graph.visible = result.stats.visibleSamples != 0;
+	graph.sampledVertices = result.simplify.verticesIn;
+	graph.envelopeTiles = result.stats.envelopeTiles;
+	graph.proxyEvaluations = result.stats.proxyEvaluations;
+	graph.stripFirsts.assign(result.stripFirsts, result.stripFirsts + result.stripCount);
+	graph.stripCounts.assign(result.stripCounts, result.stripCounts + result.stripCount);
+	glBindBuffer(GL_ARRAY_BUFFER, graph.vboObj.id);
+	graph.vboObj.amount = result.count;
+	glBufferData(GL_ARRAY_BUFFER, result.count * sizeof(glm::vec2), result.samples, GL_STATIC_DRAW);
+}
 
-void generateGraphData(const CompiledFunction& func, GLBufferInfo& vboObject) {
-	std::vector<glm::vec2, ArenaAllocator<glm::vec2>> vertexData;
-	generateGraphData(func, vboObject, vertexData);
+// waits for the workers, needed before graphEquations or the function of a graph changes
+static void finishSampling() {
+	samplerPool.wait();
+	samplerPool.collect(uploadGraphData);
 }
 
 #pragma endregion
@@ -350,45 +503,65 @@ glm::vec3 generateColor() {
 #pragma endregion
 #pragma region set function and color
 
+static void createGraphBuffers(GraphEquation& graph) {
+	graph.vboObj.id = vboAllocator.allocateVBO();
+	glGenVertexArrays(1, &graph.vao);
+	glBindVertexArray(graph.vao);
+	glBindBuffer(GL_ARRAY_BUFFER, graph.vboObj.id);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), nullptr);
+	glEnableVertexAttribArray(0);
+	glBindVertexArray(0);
+}
+
 bool setGraph(GraphEquation& graph) {
+	// a worker may still run the old function
+	finishSampling();
 
 	if (graph.vboObj.id == 0) {
-		graph.vboObj.id = vboAllocator.allocateVBO();
+		createGraphBuffers(graph);
 	}
 
 	if (graph.input.empty()) {
 		graph.func = nullptr;
+		graph.bounds.clear();
+		graph.symmetry = {};
+		graph.proxied = false;
 		clearGraphData(graph.vboObj);
+		graph.sampledVertices = 0;
+		graph.envelopeTiles = 0;
+		graph.proxyEvaluations = 0;
+		graph.stripFirsts.clear();
+		graph.stripCounts.clear();
 		return true;
 	}
 
 	{
-		// the tokens have a string_view to a member string of the lexer
-		// therfore you cannot call the destructor on the lexer before the parser has finished
-		Lexer lexer(graph.input);
-		std::optional<std::vector<Token, ArenaAllocator<Token>>> tokenArrayOpt = lexer.lexerLexAllTokens();
-		// lexer.lexerDebugPrintArray(*tokenArrayOpt);
-
-		if (!tokenArrayOpt.has_value()) {
-			return false;
-		}
-
-		Parser parser(*tokenArrayOpt);
-		// lifetime of tree pointer is the same as the parser object lifetime
-		ExpressionNode* tree = parser.parserParseExpression();
-		// parser.parserDebugDumpTree(tree);
-		if (parser.hasError) {
+		// frame arena memory used while parsing and compiling is not needed afterwards
+		ArenaScope scope;
+		ArenaTag tag("setGraph");
+		// only the tokens around the edit are lexed again and unchanged subtrees are reused,
+		// the tree lives in the arena of graph.parser until the next parse
+		ExpressionNode* tree = graph.parser.parse(graph.input);
+		if (tree == nullptr) {
 			return false;
 		}
 
 		JITCompiler jit;
 		graph.func = jit.compile(tree);
+		if (!graph.bounds.compile(tree)) {
+			wlog("the expression is too deep for interval bounds, it is sampled without them");
+		}
+		graph.symmetry = analyzeSymmetry(tree);
+		graph.proxied = isWorthProxying(tree);
 	}
 
 	if (graph.color.x == 0.0f && graph.color.y == 0.0f && graph.color.z == 0.0f) {
 		graph.color = generateColor();
 	}
-	generateGraphData(graph.func, graph.vboObj);
+	graph.tileCache.clear();
+	// the buffer is of the old function, it is as far off as a buffer of another view
+	graph.sampled.scale = 0.0f;
+	requestGraphData(graph);
 
 	return true;
 }
@@ -397,11 +570,13 @@ void removeGraph(int index) {
 	assert(!graphEquations.empty());
 	assert(0 <= index && index < graphEquations.size());
 
+	finishSampling();
 	GraphEquation& graph = graphEquations[index];
 
 	graph.func = nullptr;
 	clearGraphData(graph.vboObj);
 	vboAllocator.freeVBO(graph.vboObj.id);
+	glDeleteVertexArrays(1, &graph.vao);
 	graphEquations.erase(graphEquations.begin() + index);
 }
 
@@ -412,67 +587,278 @@ void removeGraph(int index) {
 int inputTextCallback(ImGuiInputTextCallbackData* data) {
 	size_t index = reinterpret_cast<size_t>(data->UserData) - 1;
 	if (data->EventFlag == ImGuiInputTextFlags_CallbackEdit) {
-		graphEquations[index].input = data->Buf;
+		// ImGui only reports the cursor, not the replaced range (paste, undo, selection),
+		// so the parser finds the edited range itself by comparing with the previous text
+		graphEquations[index].input.assign(data->Buf, static_cast<size_t>(data->BufTextLen));
 		setGraph(graphEquations[index]); // Update the graph with both inputs
 	}
 	return 0;
 }
 
+#pragma endregion
+#pragma region sampling widget
+
+static void drawSamplingWindow() {
+	ImGui::SetNextWindowCollapsed(true, ImGuiCond_FirstUseEver);
+	ImGui::Begin("Sampling", nullptr, ImGuiWindowFlags_AlwaysAutoResize);
+	ImGui::SliderFloat("budget per frame (ms)", &sampleScheduler.budgetMs, 0.5f, 16.0f);
+	const SchedulerStats& stats = sampleScheduler.getLastFrameStats();
+	ImGui::Text("%zu workers", samplerPool.getThreadCount());
+	ImGui::Text("submitted %zu jobs, estimated %.2f ms", stats.submittedJobs, stats.submittedMs);
+	ImGui::Text("finished %zu jobs, measured %.2f ms", stats.finishedJobs, stats.finishedMs);
+	ImGui::Text("backlog %zu curves", stats.backlog);
+	if (ImGui::BeginTable("curves", 9, ImGuiTableFlags_Borders)) {
+		ImGui::TableSetupColumn("curve");
+		ImGui::TableSetupColumn("error (px)");
+		ImGui::TableSetupColumn("vertices in");
+		ImGui::TableSetupColumn("vertices out");
+		ImGui::TableSetupColumn("strips");
+		ImGui::TableSetupColumn("envelope tiles");
+		ImGui::TableSetupColumn("symmetry");
+		ImGui::TableSetupColumn("proxy evals");
+		ImGui::TableSetupColumn("job (ms)");
+		ImGui::TableHeadersRow();
+		for (size_t i = 0; i < graphEquations.size(); i++) {
+			const GraphEquation& graph = graphEquations[i];
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn();
+			ImGui::Text("%zu", i);
+			ImGui::TableNextColumn();
+			ImGui::Text("%.2f", getScreenError(graph));
+			ImGui::TableNextColumn();
+			ImGui::Text("%zu", graph.sampledVertices);
+			ImGui::TableNextColumn();
+			ImGui::Text("%zu", graph.vboObj.amount);
+			ImGui::TableNextColumn();
+			ImGui::Text("%zu", graph.stripFirsts.size());
+			ImGui::TableNextColumn();
+			ImGui::Text("%zu", graph.envelopeTiles);
+			ImGui::TableNextColumn();
+			static constexpr const char* parityNames[] = {"odd", "", "even"};
+			ImGui::Text("%s", parityNames[static_cast<int>(graph.symmetry.parity) + 1]);
+			if (graph.symmetry.period > 0.0) {
+				ImGui::SameLine();
+				ImGui::Text("period %g", graph.symmetry.period);
+			}
+			ImGui::TableNextColumn();
+			ImGui::Text("%zu", graph.proxyEvaluations);
+			ImGui::TableNextColumn();
+			ImGui::Text("%.2f", graph.jobMs);
+		}
+		ImGui::EndTable();
+	}
+	ImGui::End();
+}
+
+#pragma endregion
+#pragma region arena stats widget
+#if ARENA_STATS
+
+template <typename Callback> static void forEachArena(Callback callback) {
+	callback(global_arena, "frame");
+	for (size_t i = 0; i < graphEquations.size(); i++) {
+		// a worker allocates tiles in the samples arena until the result of its job is collected
+		if (!graphEquations[i].jobInFlight) {
+			callback(*graphEquations[i].arena, "samples", i);
+		}
+		callback(graphEquations[i].parser.getNodeArena(), "parser", i);
+	}
+}
+
+// appends one line of JSON with the stats of every arena
+static void dumpArenaStats(const char* path) {
+	static size_t dumpIndex = 0;
+	FILE* file = fopen(path, "a");
+	if (file == nullptr) {
+		elog("failed to open", path);
+		return;
+	}
+	fprintf(file, "{\"dump\":%zu,\"arenas\":[", dumpIndex++);
+	bool first = true;
+	// in the frame arena, like every other scratch buffer of the render thread
+	ArenaScope scope;
+	ArenaVector<char> buffer;
+	buffer.resize(4096);
+	forEachArena([&](const Arena& arena, const char* kind, size_t index = 0) {
+		if (arena.begin == nullptr) {
+			return;
+		}
+		char name[64];
+		snprintf(name, sizeof(name), "%s %zu", kind, index);
+		int length = arena_stats_json(&arena, name, buffer.data(), buffer.size());
+		if (length >= static_cast<int>(buffer.size())) {
+			buffer.resize(length + 1);
+			arena_stats_json(&arena, name, buffer.data(), buffer.size());
+		}
+		fprintf(file, "%s%s", first ? "" : ",", buffer.data());
+		first = false;
+	});
+	fprintf(file, "]}\n");
+	fclose(file);
+}
+
+static void drawArenaStatsWindow() {
+	ImGui::Begin("Arena stats", nullptr, ImGuiWindowFlags_AlwaysAutoResize);
+	if (ImGui::Button("dump to arenaStats.jsonl")) {
+		dumpArenaStats("arenaStats.jsonl");
+	}
+
+	forEachArena([](const Arena& arena, const char* kind, size_t index = 0) {
+		if (arena.begin == nullptr) {
+			return;
+		}
+		ImGui::PushID(&arena);
+		if (ImGui::TreeNode("arena", "%s %zu", kind, index)) {
+			size_t committed = 0;
+			size_t used = 0;
+			for (const Region* r = arena.begin; r != nullptr; r = r->next) {
+				committed += r->committed * sizeof(uintptr_t);
+				used += r->count * sizeof(uintptr_t);
+			}
+			const ArenaStats& stats = arena.stats;
+			ImGui::Text("used %zu / committed %zu bytes", used, committed);
+			ImGui::Text("last frame %zu bytes, peak %zu, high-water mark %zu", stats.last_frame_bytes,
+						stats.peak_used_bytes, arena.high_water_bytes);
+			ImGui::Text("new regions %zu, skipped regions %zu, oversize %zu", stats.new_regions, stats.skipped_regions,
+						stats.oversize_allocs);
+			ImGui::Text("realloc waste %zu bytes", arena.realloc_wasted_bytes);
+			if (ImGui::BeginTable("tags", 4, ImGuiTableFlags_Borders)) {
+				ImGui::TableSetupColumn("tag");
+				ImGui::TableSetupColumn("allocations");
+				ImGui::TableSetupColumn("last frame");
+				ImGui::TableSetupColumn("total");
+				ImGui::TableHeadersRow();
+				for (size_t i = 0; i <= stats.tag_count; i++) {
+					const ArenaTagStats& tag = stats.tags[i];
+					ImGui::TableNextRow();
+					ImGui::TableNextColumn();
+					ImGui::TextUnformatted(tag.name != nullptr ? tag.name : "untagged");
+					ImGui::TableNextColumn();
+					ImGui::Text("%zu", tag.allocations);
+					ImGui::TableNextColumn();
+					ImGui::Text("%zu", tag.last_frame_bytes);
+					ImGui::TableNextColumn();
+					ImGui::Text("%zu", tag.total_bytes);
+				}
+				ImGui::EndTable();
+			}
+			ImGui::TreePop();
+		}
+		ImGui::PopID();
+	});
+	ImGui::End();
+}
+
+#endif
+#pragma endregion
+#pragma region allocation counter widget
+#if COUNT_ALLOCATIONS
+
+// the counts are of the previous frame, this one is still running
+static void drawAllocationCounterWindow() {
+	static size_t framesWithAllocations = 0;
+	static size_t maxAllocations = 0;
+	const AllocationCount count = allocationCounterEndFrame();
+	framesWithAllocations += count.allocations != 0;
+	maxAllocations = std::max(maxAllocations, count.allocations);
+
+	ImGui::Begin("Heap allocations", nullptr, ImGuiWindowFlags_AlwaysAutoResize);
+	ImGui::Text("last frame %zu allocations, %zu bytes", count.allocations, count.bytes);
+	ImGui::Text("frames that allocated %zu, most in one frame %zu", framesWithAllocations, maxAllocations);
+	if (ImGui::Button("reset")) {
+		framesWithAllocations = 0;
+		maxAllocations = 0;
+	}
+	ImGui::SameLine();
+	if (ImGui::Button("report call sites to stderr")) {
+		allocationCounterReport(stderr);
+	}
+	ImGui::End();
+}
+
+#endif
 #pragma endregion
 #pragma region mainSuff
 
 bool gameLogic(float deltaTime, int w, int h) {
 	glClear(GL_COLOR_BUFFER_BIT); // Clear screen
 
-	bool shouldRecalculateEverything = false;
+	// upload what the workers finished since the last frame
+	samplerPool.collect(uploadGraphData);
+
+	bool viewChanged = false;
+	if (framebufferSize != glm::ivec2(w, h) && w > 0 && h > 0) {
+		framebufferSize = {w, h};
+		// the tiles were refined for the old aspect ratio
+		finishSampling();
+		for (GraphEquation& graph : graphEquations) {
+			graph.tileCache.clear();
+			graph.sampled.scale = 0.0f;
+		}
+		viewChanged = true;
+	}
 
 #pragma region draw grid using shader
+	setViewUniforms(gridRange);
 	glUniform4f(lineColorUniform, 0.1f, 0.1f, 0.1f, 1.0f);
 	for (int i = 0; i < 3; i++) {
 		glUniform1f(lineThicknessUniform, (2 * i + 1) / 1000.0f);
-		glEnableVertexAttribArray(0);
 		glBindVertexArray(gridVaos[i].id);
 		glDrawArrays(GL_LINES, 0, gridVaos[i].amount);
-		glDisableVertexAttribArray(0);
 	}
 #pragma endregion
 #pragma region draw graphs
 	// Draw graph for each function
 	glUniform1f(lineThicknessUniform, 8.0f / 1000.0f);
 	for (const auto& graph : graphEquations) {
-
-		glBindBuffer(GL_ARRAY_BUFFER, graph.vboObj.id);
-		glEnableClientState(GL_VERTEX_ARRAY);
-		glVertexPointer(2, GL_FLOAT, 0, nullptr); // Set up vertex pointer
+		if (graph.vao == 0) {
+			continue;
+		}
+		setViewUniforms(graph.sampled);
+		glBindVertexArray(graph.vao);
 		glUniform4f(lineColorUniform, graph.color.x, graph.color.y, graph.color.z,
 					1.0f);									 // Set different color for each function
-		glDrawArrays(GL_LINE_STRIP, 0, graph.vboObj.amount); // Draw the line strip
-		glDisableClientState(GL_VERTEX_ARRAY);
+		// one strip per piece of the curve between its poles, jumps and NaN runs
+		glMultiDrawArrays(GL_LINE_STRIP, graph.stripFirsts.data(), graph.stripCounts.data(),
+						  static_cast<GLsizei>(graph.stripFirsts.size()));
 	}
+	glBindVertexArray(0);
 // glUseProgram(0);
 #pragma endregion
 #pragma region display equations widget
 	ImGui::Begin("Equations", nullptr,
 				 ImGuiWindowFlags_NoTitleBar | ImGuiWindowFlags_NoScrollbar | ImGuiWindowFlags_AlwaysAutoResize);
 	for (size_t i = 0; i < graphEquations.size(); i++) {
-		ImGui::InputText(("##" + std::to_string(i)).c_str(), &graphEquations[i].input, ImGuiInputTextFlags_CallbackEdit,
-						 inputTextCallback, (void*)(i + 1));
+		// an id instead of a "##i" label, building the label allocated every frame
+		ImGui::PushID(static_cast<int>(i));
+		ImGui::InputText("##input", &graphEquations[i].input, ImGuiInputTextFlags_CallbackEdit, inputTextCallback,
+						 (void*)(i + 1));
 		ImGui::SameLine();
 		ImGui::PushStyleColor(ImGuiCol_Button, ImVec4(1.0f, 0.0f, 0.0f, 1.0f));		   // Red button color
 		ImGui::PushStyleColor(ImGuiCol_ButtonHovered, ImVec4(0.8f, 0.0f, 0.0f, 1.0f)); // Darker red when hovered
 		ImGui::PushStyleColor(ImGuiCol_ButtonActive, ImVec4(0.6f, 0.0f, 0.0f, 1.0f));  // Even darker red when pressed
-		if (ImGui::Button(("X##" + std::to_string(i)).c_str())) {
+		if (ImGui::Button("X")) {
 			removeGraph(i);
 		}
 		ImGui::PopStyleColor(3);
+		ImGui::PopID();
 	}
 	if (ImGui::Button("add equation", {100.0f, 25.0f})) {
+		// the jobs point into graphEquations
+		finishSampling();
 		graphEquations.resize(graphEquations.size() + 1);
 	}
-	shouldRecalculateEverything |= ImGui::SliderFloat("Scale", &scale, 0.001f, 10.0f);
-	shouldRecalculateEverything |= ImGui::SliderFloat("OriginX", &origin.x, -5.0f, 5.0f);
-	shouldRecalculateEverything |= ImGui::SliderFloat("OriginY", &origin.y, -5.0f, 5.0f);
+	viewChanged |= ImGui::SliderFloat("Scale", &scale, 0.001f, 10.0f);
+	viewChanged |= ImGui::SliderFloat("OriginX", &origin.x, -5.0f, 5.0f);
+	viewChanged |= ImGui::SliderFloat("OriginY", &origin.y, -5.0f, 5.0f);
 	ImGui::End();
+	drawSamplingWindow();
+#if ARENA_STATS
+	drawArenaStatsWindow();
+#endif
+#if COUNT_ALLOCATIONS
+	drawAllocationCounterWindow();
+#endif
 #pragma endregion
 
 #pragma region move with cursor
@@ -490,26 +876,29 @@ bool gameLogic(float deltaTime, int w, int h) {
 		glm::vec2 delta = 2.0f * static_cast<glm::vec2>(originMousePos - currentMousePos); // Delta in pixels
 		origin = originOrigin + (delta / scale) / glm::vec2({w, h}); // Scale and update the origin
 
-		shouldRecalculateEverything = true;
+		viewChanged = true;
 	}
 
 	double scrollSize = platform::getScrollSize();
 	if (scrollSize != 0) {
 		scale *= exp(scrollSize / scrollSensitivity);
 		scale = std::clamp(scale, 0.001f, 1000.0f);
-		shouldRecalculateEverything = true;
+		viewChanged = true;
 	}
 
 #pragma endregion
-	// reset early
-	if (shouldRecalculateEverything) {
-		generateAxisData();
-		arena_reset(&global_arena); // early reset cause this requires alot of vertexes
-		std::vector<glm::vec2, ArenaAllocator<glm::vec2>> vertexData;
+	// the vertex shader moves the buffers with the view, they are only generated again once the view leaves them
+	if (viewChanged) {
+		if (!coversView(gridRange) || getGridSpacing() != gridSpacing) {
+			generateAxisData();
+		}
 		for (GraphEquation& graph : graphEquations) {
-			generateGraphData(graph.func, graph.vboObj, vertexData);
+			if (!coversView(graph.sampled)) {
+				requestGraphData(graph);
+			}
 		}
 	}
+	scheduleGraphJobs();
 
 #pragma region fullscreen
 /*
@@ -531,7 +920,8 @@ bool gameLogic(float deltaTime, int w, int h) {
 #pragma endregion
 
 
-	arena_reset(&global_arena);
+	arena_reset_and_trim(&global_arena, &frameArenaTrimPolicy);
+	frameIndex++;
 	return true;
 }
 
@@ -563,8 +953,12 @@ bool gameInit() {
 
 	lineThicknessUniform = glGetUniformLocation(shaderProgram, "lineThickness");
 	lineColorUniform = glGetUniformLocation(shaderProgram, "lineColor");
+	viewOffsetUniform = glGetUniformLocation(shaderProgram, "viewOffset");
+	viewScaleUniform = glGetUniformLocation(shaderProgram, "viewScale");
 #pragma endregion
 	
+	// the render thread keeps a core of its own
+	samplerPool.init(std::max(std::thread::hardware_concurrency(), 2u) - 1);
 	vboAllocator.reserve(VBOAllocator::DEFAULT_VBO_RESERVE_AMOUNT);
 	gridVbo = vboAllocator.allocateVBO();
 
@@ -577,8 +971,8 @@ bool gameInit() {
 	firstGraph.input = "x*x";
 	firstGraph.color = generateColor();
 	firstGraph.func = [](double x) { return x * x; };
-	firstGraph.vboObj.id = vboAllocator.allocateVBO();
-	generateGraphData(firstGraph.func, firstGraph.vboObj);
+	createGraphBuffers(firstGraph);
+	requestGraphData(firstGraph);
 	generateAxisData();
 
 	glUseProgram(shaderProgram);
@@ -586,6 +980,8 @@ bool gameInit() {
 }
 
 void gameEnd() {
+	// a std::thread that is still joinable terminates the program when it is destroyed
+	samplerPool.shutdown();
 
 	// there is no reasone to free all of these since the OS does this for us
 	// It is just here just incase
@@ -1,4 +1,5 @@
 #include "graphMain.hpp"
+#include "allocationCounter.hpp"
 #include <GLFW/glfw3.h>
 #include "mainGui.hpp"
 #include "opterPlatformFunctions.hpp"
@@ -339,6 +340,9 @@ int guiLoop() {
 #pragma endregion
 
 #pragma region imgui init
+#if COUNT_ALLOCATIONS
+	allocationCounterInstallImGuiHooks();
+#endif
 	ImGui::CreateContext();
 
 	imguiThemes::embraceTheDarkness();
@@ -0,0 +1,162 @@
+#include "polylineSimplifier.hpp"
+#include <cstdint>
+#include <cstring>
+
+#pragma region helperFunction
+
+static inline void pushBreak(SampleVector& out) {
+	if (!out.empty() && !isSampleBreak(out.back())) {
+		out.push_back(sampleBreak);
+	}
+}
+
+// the point where the segment from a to b crosses the height edge
+static inline glm::vec2 intersectHeight(glm::vec2 a, glm::vec2 b, double edge) {
+	const double t = (edge - a.y) / (static_cast<double>(b.y) - a.y);
+	return {static_cast<float>(a.x + t * (static_cast<double>(b.x) - a.x)), static_cast<float>(edge)};
+}
+
+// replaces every run of samples on one side outside of [low, high] by the two points where the curve
+// leaves and enters again, those are joined by a line along the edge that is never seen
+static void clipSamples(const glm::vec2* samples, size_t count, double low, double high, SampleVector& out) {
+	glm::vec2 previous{};
+	int previousSide = 0;
+	bool hasPrevious = false;
+	for (size_t i = 0; i < count; i++) {
+		const glm::vec2 sample = samples[i];
+		if (isSampleBreak(sample)) {
+			pushBreak(out);
+			hasPrevious = false;
+			continue;
+		}
+		const int side = sample.y > high ? 1 : (sample.y < low ? -1 : 0);
+		if (!hasPrevious) {
+			if (side == 0) {
+				out.push_back(sample);
+			}
+		} else {
+			if (previousSide != 0 && previousSide != side) {
+				out.push_back(intersectHeight(previous, sample, previousSide > 0 ? high : low));
+			}
+			if (side != 0 && side != previousSide) {
+				out.push_back(intersectHeight(previous, sample, side > 0 ? high : low));
+			}
+			if (side == 0) {
+				out.push_back(sample);
+			}
+		}
+		previous = sample;
+		previousSide = side;
+		hasPrevious = true;
+	}
+	if (!out.empty() && isSampleBreak(out.back())) {
+		out.pop_back();
+	}
+}
+
+// squared distance in pixels of p from the segment from a to b
+static inline double segmentDistanceSquared(glm::dvec2 p, glm::dvec2 a, glm::dvec2 b) {
+	const glm::dvec2 ab = b - a;
+	const double length = glm::dot(ab, ab);
+	double t = length > 0.0 ? glm::dot(p - a, ab) / length : 0.0;
+	t = t < 0.0 ? 0.0 : (t > 1.0 ? 1.0 : t);
+	const glm::dvec2 d = p - (a + t * ab);
+	return glm::dot(d, d);
+}
+
+struct SimplifyRange {
+	uint32_t first;
+	uint32_t last;
+};
+
+// Douglas-Peucker over [first, last], marks the vertices that are kept
+static void simplifyStrip(const glm::vec2* points, uint32_t first, uint32_t last, glm::dvec2 toPixels,
+						  double toleranceSquared, uint8_t* keep, SimplifyRange* stack) {
+	keep[first] = 1;
+	keep[last] = 1;
+	size_t stackSize = 0;
+	stack[stackSize++] = {first, last};
+	while (stackSize != 0) {
+		const SimplifyRange range = stack[--stackSize];
+		if (range.last - range.first < 2) {
+			continue;
+		}
+		const glm::dvec2 a = glm::dvec2(points[range.first]) * toPixels;
+		const glm::dvec2 b = glm::dvec2(points[range.last]) * toPixels;
+		double furthest = -1.0;
+		uint32_t furthestIndex = range.first;
+		for (uint32_t i = range.first + 1; i < range.last; i++) {
+			const double distance = segmentDistanceSquared(glm::dvec2(points[i]) * toPixels, a, b);
+			if (distance > furthest) {
+				furthest = distance;
+				furthestIndex = i;
+			}
+		}
+		if (furthest <= toleranceSquared) {
+			continue;
+		}
+		keep[furthestIndex] = 1;
+		stack[stackSize++] = {range.first, furthestIndex};
+		stack[stackSize++] = {furthestIndex, range.last};
+	}
+}
+
+#pragma endregion
+#pragma region majorFunctions
+
+SimplifyStats simplifySamples(const glm::vec2* samples, size_t count, const SampleView& view, double yMin,
+							  double yMax, const SimplifySettings& settings, Arena* scratch, SampleVector& out) {
+	out.clear();
+	SimplifyStats stats{};
+	stats.verticesIn = count;
+	if (count == 0) {
+		return stats;
+	}
+
+	// samples are (p - anchor) * outputScale, the band and the margin are moved into the same units
+	const glm::dvec2 toPixels = glm::dvec2(view.pixelsPerUnitX, view.pixelsPerUnitY) / view.outputScale;
+	const double margin = settings.clipMarginPixels / toPixels.y;
+	const double low = (yMin - view.anchor.y) * view.outputScale - margin;
+	const double high = (yMax - view.anchor.y) * view.outputScale + margin;
+	// out grows before the scope below is opened, it is only compacted inside of it
+	out.reserve(count);
+	clipSamples(samples, count, low, high, out);
+
+	ArenaScope scope(scratch);
+	const size_t clipped = out.size();
+	uint8_t* keep = static_cast<uint8_t*>(arena_alloc(scratch, clipped));
+	SimplifyRange* stack = static_cast<SimplifyRange*>(arena_alloc(scratch, clipped * sizeof(SimplifyRange)));
+	if (keep == nullptr || stack == nullptr) {
+		stats.verticesOut = clipped;
+		return stats;
+	}
+	memset(keep, 0, clipped);
+
+	const double toleranceSquared = static_cast<double>(settings.tolerancePixels) * settings.tolerancePixels;
+	size_t first = 0;
+	for (size_t i = 0; i <= clipped; i++) {
+		if (i != clipped && !isSampleBreak(out[i])) {
+			continue;
+		}
+		if (i != clipped) {
+			keep[i] = 1;
+		}
+		if (i > first) {
+			simplifyStrip(out.data(), static_cast<uint32_t>(first), static_cast<uint32_t>(i - 1), toPixels,
+						  toleranceSquared, keep, stack);
+		}
+		first = i + 1;
+	}
+
+	size_t kept = 0;
+	for (size_t i = 0; i < clipped; i++) {
+		if (keep[i]) {
+			out[kept++] = out[i];
+		}
+	}
+	out.resize(kept);
+	stats.verticesOut = kept;
+	return stats;
+}
+
+#pragma endregion
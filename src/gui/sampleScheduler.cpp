@@ -0,0 +1,49 @@
+#include "sampleScheduler.hpp"
+#include <algorithm>
+#include <cmath>
+
+SamplerSettings SampleScheduler::nextPass(const SamplerSettings& final, float currentError) const {
+	SamplerSettings settings = final;
+	const float error = std::isfinite(currentError) ? currentError / refineFactor : coarsePixelError;
+	if (error <= final.maxPixelError) {
+		return settings;
+	}
+	// coarse passes also start from wider segments, they are about showing something quickly
+	const float coarseness = error / final.maxPixelError;
+	settings.maxPixelError = error;
+	settings.initialSegmentPixels = std::min(final.initialSegmentPixels * std::sqrt(coarseness), 64.0f);
+	settings.sampleBudget = std::max(final.sampleBudget / static_cast<size_t>(coarseness), size_t(256));
+	return settings;
+}
+
+size_t SampleScheduler::plan(ScheduleCandidate* candidates, size_t count, size_t threadCount) {
+	std::sort(candidates, candidates + count, [](const ScheduleCandidate& a, const ScheduleCandidate& b) {
+		if (a.visible != b.visible) {
+			return a.visible;
+		}
+		return a.screenError > b.screenError;
+	});
+
+	const float capacityMs = budgetMs * static_cast<float>(std::max(threadCount, size_t(1)));
+	size_t planned = 0;
+	float plannedMs = 0.0f;
+	while (planned < count && (planned == 0 || plannedMs + candidates[planned].estimatedMs <= capacityMs)) {
+		plannedMs += candidates[planned].estimatedMs;
+		planned++;
+	}
+
+	frame.submittedJobs += planned;
+	frame.submittedMs += plannedMs;
+	frame.backlog = count - planned;
+	return planned;
+}
+
+void SampleScheduler::recordFinished(float milliseconds) {
+	frame.finishedJobs++;
+	frame.finishedMs += milliseconds;
+}
+
+void SampleScheduler::endFrame() {
+	lastFrame = frame;
+	frame = {};
+}
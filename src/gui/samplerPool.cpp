@@ -0,0 +1,134 @@
+#include "samplerPool.hpp"
+#include "tools.hpp"
+#include <chrono>
+#include <cstring>
+
+// enough for every curve of a session, so the queues don't grow while panning
+static constexpr size_t initialQueueCapacity = 64;
+// words reserved for published results, 64 MiB holds the samples of every curve many times over
+static constexpr size_t resultArenaWords = size_t(1) << 23;
+
+void SamplerPool::init(size_t threadCount) {
+	for (ConcurrentArena& arena : resultArenas) {
+		concurrent_arena_init(&arena, resultArenaWords);
+	}
+	arena_init(&inlineScratch, REGION_DEFAULT_CAPACITY);
+	jobs.reserve(initialQueueCapacity);
+	results.reserve(initialQueueCapacity);
+	collecting.reserve(initialQueueCapacity);
+
+	workers.reserve(threadCount);
+	for (size_t i = 0; i < threadCount; i++) {
+		workers.emplace_back(&SamplerPool::workerMain, this);
+	}
+}
+
+void SamplerPool::shutdown() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	jobAvailable.notify_all();
+	for (std::thread& worker : workers) {
+		worker.join();
+	}
+	workers.clear();
+	for (ConcurrentArena& arena : resultArenas) {
+		concurrent_arena_free(&arena);
+	}
+	arena_free(&inlineScratch);
+}
+
+void SamplerPool::submit(const SampleJob& job) {
+	if (workers.empty()) {
+		SampleResult result;
+		runJob(job, currentArena, &inlineScratch, result);
+		std::lock_guard<std::mutex> lock(mutex);
+		pendingResults[currentArena]++;
+		results.push_back(result);
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		jobs.push_back({job, currentArena});
+		pendingResults[currentArena]++;
+		unfinishedJobs++;
+	}
+	jobAvailable.notify_one();
+}
+
+void SamplerPool::wait() {
+	std::unique_lock<std::mutex> lock(mutex);
+	jobFinished.wait(lock, [this] { return unfinishedJobs == 0; });
+}
+
+void SamplerPool::takeResults(std::vector<SampleResult>& out) {
+	std::lock_guard<std::mutex> lock(mutex);
+	std::swap(out, results);
+}
+
+void SamplerPool::runJob(const SampleJob& job, size_t arenaSlot, Arena* scratch, SampleResult& result) {
+	const auto begin = std::chrono::steady_clock::now();
+	ArenaScope scope(scratch);
+	SampleVector gathered(scratch);
+	SampleVector samples(scratch);
+	result.owner = job.owner;
+	result.generation = job.generation;
+	result.view = job.view;
+	result.arenaSlot = arenaSlot;
+	result.stats = job.cache->gather(job.func, job.bounds, job.symmetry, job.view, job.settings, job.frame, scratch,
+									 gathered);
+	result.simplify = simplifySamples(gathered.data(), gathered.size(), job.view, result.stats.yMin, result.stats.yMax,
+									  job.simplify, scratch, samples);
+
+	const size_t bytes = samples.size() * sizeof(glm::vec2);
+	const size_t maxStrips = samples.size() / 2 + 1;
+	ConcurrentArena* resultArena = &resultArenas[arenaSlot];
+	glm::vec2* published = static_cast<glm::vec2*>(concurrent_arena_alloc(resultArena, bytes));
+	int32_t* stripFirsts = static_cast<int32_t*>(concurrent_arena_alloc(resultArena, maxStrips * sizeof(int32_t)));
+	int32_t* stripCounts = static_cast<int32_t*>(concurrent_arena_alloc(resultArena, maxStrips * sizeof(int32_t)));
+	if (published == nullptr || stripFirsts == nullptr || stripCounts == nullptr) {
+		wlog("sampler result memory is used up, dropping a curve");
+		return;
+	}
+	memcpy(published, samples.data(), bytes);
+	result.samples = published;
+	result.count = samples.size();
+	result.stripCount = findSampleStrips(published, samples.size(), stripFirsts, stripCounts);
+	result.stripFirsts = stripFirsts;
+	result.stripCounts = stripCounts;
+	result.milliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - begin).count();
+}
+
+void SamplerPool::workerMain() {
+	// the scratch memory of the jobs of this thread, global_arena belongs to the render thread
+	Arena scratch{};
+	arena_init(&scratch, REGION_DEFAULT_CAPACITY);
+
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true) {
+		jobAvailable.wait(lock, [this] { return stopping || nextJob < jobs.size(); });
+		if (stopping) {
+			break;
+		}
+		// first in first out, the scheduler submits the most important curves first
+		const QueuedJob queued = jobs[nextJob++];
+		if (nextJob == jobs.size()) {
+			jobs.clear();
+			nextJob = 0;
+		}
+		lock.unlock();
+
+		SampleResult result;
+		runJob(queued.job, queued.arenaSlot, &scratch, result);
+
+		lock.lock();
+		results.push_back(result);
+		unfinishedJobs--;
+		if (unfinishedJobs == 0) {
+			jobFinished.notify_all();
+		}
+	}
+	lock.unlock();
+	arena_free(&scratch);
+}
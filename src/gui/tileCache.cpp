@@ -0,0 +1,324 @@
+#include "tileCache.hpp"
+#include "chebyshevProxy.hpp"
+#include "tools.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <new>
+
+// how many view heights above and below the view a tile is refined for
+static constexpr double tileBandViews = 2.0;
+// a tile is only repeated from one period if it holds at least this many
+static constexpr double minTilePeriods = 2.0;
+// periods narrower than this on screen are drawn as the band between their lowest and highest value
+static constexpr double minPeriodPixels = 2.0;
+
+#pragma region helperFunction
+
+// min/max columns over the tile of a curve whose period is too narrow to be seen, all columns are the same
+// band, so only one period is sampled for it, stretched to a full tile width
+static SampleStats samplePeriodBand(calcFunction func, const IntervalFunction* bounds, const ChebyshevProxy* proxy,
+									double period, const SampleView& tileView, const SamplerSettings& settings,
+									SampleVector& out) {
+	SampleView periodView = tileView;
+	periodView.xMax = tileView.xMin + period;
+	periodView.pixelsPerUnitX = TileCache::TILE_PIXELS / period;
+	SampleStats stats = sampleCurve(func, bounds, proxy, periodView, settings, out);
+
+	float low = INFINITY;
+	float high = -INFINITY;
+	for (const glm::vec2 sample : out) {
+		if (!isSampleBreak(sample)) {
+			low = std::min(low, sample.y);
+			high = std::max(high, sample.y);
+		}
+	}
+	out.clear();
+	if (!(low <= high)) {
+		return stats;
+	}
+	const double columnWidth = (tileView.xMax - tileView.xMin) * tileView.outputScale / TileCache::TILE_PIXELS;
+	for (int column = 0; column < TileCache::TILE_PIXELS; column++) {
+		const float x = static_cast<float>((column + 0.5) * columnWidth);
+		const bool upwards = (column & 1) == 0;
+		out.push_back({x, upwards ? low : high});
+		out.push_back({x, upwards ? high : low});
+	}
+	stats.envelope = true;
+	stats.samples = out.size();
+	return stats;
+}
+
+// samples the first period of the tile and repeats it to the end, false if the copies do not fit into a tile
+static bool samplePeriods(calcFunction func, const IntervalFunction* bounds, const ChebyshevProxy* proxy,
+						  double period, const SampleView& tileView, const SamplerSettings& settings,
+						  SampleVector& out, SampleStats& stats) {
+	SampleView periodView = tileView;
+	periodView.xMax = tileView.xMin + period;
+	stats = sampleCurve(func, bounds, proxy, periodView, settings, out);
+
+	const double width = (tileView.xMax - tileView.xMin) * tileView.outputScale;
+	const double shift = period * tileView.outputScale;
+	const size_t periodSamples = out.size();
+	const size_t copies = static_cast<size_t>(std::ceil(width / shift));
+	// one more for the sample at the tile edge, the budget of a tile is at most TILE_MAX_SAMPLES
+	if (periodSamples == 0 || periodSamples * copies + 1 > settings.sampleBudget) {
+		return false;
+	}
+
+	// the last sample of a period is the first one of the next, unless the curve is not finite there
+	const uint32_t skip = out[0].x == 0.0f ? 1 : 0;
+	out.reserve(periodSamples * copies + 1);
+	double lastX = 0.0;
+	for (size_t copy = 1; copy < copies; copy++) {
+		for (size_t i = skip; i < periodSamples; i++) {
+			const glm::vec2 sample = out[i];
+			if (isSampleBreak(sample)) {
+				out.push_back(sampleBreak);
+				continue;
+			}
+			const double x = sample.x + copy * shift;
+			if (x > width) {
+				break;
+			}
+			out.push_back({static_cast<float>(x), sample.y});
+			lastX = x;
+		}
+	}
+	// the copy that is cut off ends at the tile edge
+	if (lastX < width) {
+		const double y = func(tileView.xMax);
+		stats.evaluations++;
+		out.push_back(std::isfinite(y) ? glm::vec2{static_cast<float>(width),
+												   static_cast<float>((y - tileView.anchor.y) * tileView.outputScale)}
+									   : sampleBreak);
+	}
+	stats.samples = out.size();
+	return true;
+}
+
+#pragma endregion
+
+TileCache::TileCache(Arena* arena, size_t budgetBytes) : arena(arena) {
+	maxTiles = std::max(budgetBytes / (TILE_MAX_SAMPLES * sizeof(glm::vec2)), size_t(1));
+}
+
+void TileCache::clear() {
+	// the sample memory of the tiles is kept for the next ones
+	tileCount = 0;
+}
+
+// there are only a few hundred tiles and a view needs about ten, so a linear search is fine
+CurveTile* TileCache::find(TileKey key) {
+	for (size_t i = 0; i < tileCount; i++) {
+		if (tiles[i].key == key) {
+			return &tiles[i];
+		}
+	}
+	return nullptr;
+}
+
+CurveTile* TileCache::acquire(TileKey key, TileCacheStats& stats) {
+	if (tiles == nullptr) {
+		tiles = static_cast<CurveTile*>(arena_alloc(arena, maxTiles * sizeof(CurveTile)));
+	}
+	CurveTile* tile = nullptr;
+	if (tileCount < maxTiles) {
+		if (tileCount == allocatedTiles) {
+			new (&tiles[allocatedTiles++]) CurveTile{};
+			tiles[tileCount].samples =
+				static_cast<glm::vec2*>(arena_alloc(arena, TILE_MAX_SAMPLES * sizeof(glm::vec2)));
+		}
+		tile = &tiles[tileCount++];
+	} else {
+		tile = std::min_element(tiles, tiles + tileCount, [](const CurveTile& a, const CurveTile& b) {
+			return a.lastUsed < b.lastUsed;
+		});
+		stats.evictions += tile->count != 0;
+	}
+	tile->key = key;
+	tile->count = 0;
+	tile->proxyFitted = false;
+	return tile;
+}
+
+bool TileCache::mirrorTile(CurveTile& tile, Parity parity, const SampleView& view, const SamplerSettings& settings) {
+	if (parity == Parity::None || tile.key.index >= 0) {
+		return false;
+	}
+	// [-(k + 1), -k) * 2^level is the mirror image of [k, k + 1) * 2^level
+	const CurveTile* mirror = find({tile.key.level, -tile.key.index - 1});
+	if (mirror == nullptr || mirror->pixelError > settings.maxPixelError) {
+		return false;
+	}
+	const float sign = parity == Parity::Odd ? -1.0f : 1.0f;
+	const double yMin = parity == Parity::Odd ? -mirror->yMax : mirror->yMin;
+	const double yMax = parity == Parity::Odd ? -mirror->yMin : mirror->yMax;
+	if (!(yMin <= view.yMin && view.yMax <= yMax)) {
+		return false;
+	}
+
+	const float width = static_cast<float>(std::ldexp(1.0, tile.key.level));
+	tile.anchor = {-mirror->anchor.x - width, sign * mirror->anchor.y};
+	tile.yMin = yMin;
+	tile.yMax = yMax;
+	tile.pixelError = mirror->pixelError;
+	tile.envelope = mirror->envelope;
+	tile.count = mirror->count;
+	for (uint32_t i = 0; i < mirror->count; i++) {
+		const glm::vec2 sample = mirror->samples[mirror->count - 1 - i];
+		tile.samples[i] = isSampleBreak(sample) ? sampleBreak : glm::vec2{width - sample.x, sign * sample.y};
+	}
+	return true;
+}
+
+void TileCache::sampleTile(CurveTile& tile, calcFunction func, const IntervalFunction* bounds,
+						   const ExpressionSymmetry& symmetry, const SampleView& view, const SamplerSettings& settings,
+						   Arena* scratch, TileCacheStats& stats) {
+	if (mirrorTile(tile, symmetry.parity, view, settings)) {
+		return;
+	}
+
+	const double tileWidth = std::ldexp(1.0, tile.key.level);
+	const double viewHeight = view.yMax - view.yMin;
+
+	SampleView tileView;
+	tileView.xMin = static_cast<double>(tile.key.index) * tileWidth;
+	tileView.xMax = tileView.xMin + tileWidth;
+	tileView.yMin = view.yMin - tileBandViews * viewHeight;
+	tileView.yMax = view.yMax + tileBandViews * viewHeight;
+	// sampled for the finest scale this level is used at, so it is never coarser than the screen
+	tileView.pixelsPerUnitX = TILE_PIXELS / tileWidth;
+	tileView.pixelsPerUnitY = tileView.pixelsPerUnitX * view.pixelsPerUnitY / view.pixelsPerUnitX;
+
+	const double centerY = func(0.5 * (tileView.xMin + tileView.xMax));
+	stats.evaluations++;
+	tileView.anchor = {tileView.xMin, std::isfinite(centerY) ? centerY : 0.0};
+	tileView.outputScale = 1.0;
+
+	SamplerSettings tileSettings = settings;
+	tileSettings.sampleBudget = std::min(settings.sampleBudget, TILE_MAX_SAMPLES);
+
+	const bool periodic = symmetry.period > 0.0 && symmetry.period * minTilePeriods <= tileWidth;
+
+	// sampled in scratch and copied, the tile memory has a fixed size
+	ArenaScope scope(scratch);
+	SampleVector samples(scratch);
+
+	// only fitted over the part that is evaluated, which is one period for a periodic tile
+	if (settings.chebyshevProxy && tile.proxy == nullptr) {
+		void* memory = arena_alloc(arena, sizeof(ChebyshevProxy));
+		tile.proxy = memory != nullptr ? new (memory) ChebyshevProxy : nullptr;
+	}
+	const ChebyshevProxy* proxy = settings.chebyshevProxy ? tile.proxy : nullptr;
+	if (proxy != nullptr && !tile.proxyFitted) {
+		const double fitMax = periodic ? tileView.xMin + symmetry.period : tileView.xMax;
+		const ProxyStats proxyStats = tile.proxy->fit(func, bounds, tileView.xMin, fitMax,
+													  settings.proxyTolerancePixels / tileView.pixelsPerUnitY);
+		stats.evaluations += proxyStats.evaluations;
+		stats.intervalEvaluations += proxyStats.intervalEvaluations;
+		tile.proxyFitted = true;
+	}
+
+	SampleStats sampleStats{};
+	bool repeated = false;
+	if (periodic) {
+		if (symmetry.period * tileView.pixelsPerUnitX < minPeriodPixels) {
+			sampleStats = samplePeriodBand(func, bounds, proxy, symmetry.period, tileView, tileSettings, samples);
+			repeated = true;
+		} else {
+			repeated =
+				samplePeriods(func, bounds, proxy, symmetry.period, tileView, tileSettings, samples, sampleStats);
+			if (!repeated) {
+				stats.evaluations += sampleStats.evaluations;
+				stats.intervalEvaluations += sampleStats.intervalEvaluations;
+				stats.proxyEvaluations += sampleStats.proxyEvaluations;
+			}
+		}
+	}
+	if (!repeated) {
+		sampleStats = sampleCurve(func, bounds, proxy, tileView, tileSettings, samples);
+	}
+	stats.evaluations += sampleStats.evaluations;
+	stats.intervalEvaluations += sampleStats.intervalEvaluations;
+	stats.proxyEvaluations += sampleStats.proxyEvaluations;
+
+	tile.anchor = tileView.anchor;
+	tile.yMin = tileView.yMin;
+	tile.yMax = tileView.yMax;
+	tile.pixelError = settings.maxPixelError;
+	tile.envelope = sampleStats.envelope;
+	// the sampler keeps to the budget, this only guards the fixed tile memory
+	tile.count = static_cast<uint32_t>(std::min(samples.size(), TILE_MAX_SAMPLES));
+	memcpy(tile.samples, samples.data(), tile.count * sizeof(glm::vec2));
+}
+
+void TileCache::ensureTile(TileKey key, calcFunction func, const IntervalFunction* bounds,
+						   const ExpressionSymmetry& symmetry, const SampleView& view, const SamplerSettings& settings,
+						   uint64_t frame, Arena* scratch, TileCacheStats& stats) {
+	CurveTile* tile = find(key);
+	if (tile != nullptr && tile->yMin <= view.yMin && view.yMax <= tile->yMax &&
+		tile->pixelError <= settings.maxPixelError) {
+		stats.hits++;
+	} else {
+		if (tile == nullptr) {
+			tile = acquire(key, stats);
+		}
+		stats.misses++;
+		sampleTile(*tile, func, bounds, symmetry, view, settings, scratch, stats);
+	}
+	tile->lastUsed = frame;
+}
+
+TileCacheStats TileCache::gather(calcFunction func, const IntervalFunction* bounds, const ExpressionSymmetry& symmetry,
+								 const SampleView& view, const SamplerSettings& settings, uint64_t frame,
+								 Arena* scratch, SampleVector& out) {
+	TileCacheStats stats{};
+	if (func == nullptr || !(view.xMax > view.xMin)) {
+		return stats;
+	}
+
+	// the level whose tiles are between TILE_PIXELS / 2 and TILE_PIXELS wide on screen
+	const int32_t level = static_cast<int32_t>(std::floor(std::log2(TILE_PIXELS / view.pixelsPerUnitX)));
+	const double tileWidth = std::ldexp(1.0, level);
+	const int64_t first = static_cast<int64_t>(std::floor(view.xMin / tileWidth));
+	const int64_t last = static_cast<int64_t>(std::floor(view.xMax / tileWidth));
+
+	// the tiles right of x = 0 are made ready first, so the ones left of it find their mirror image in the cache
+	const int64_t split = symmetry.parity == Parity::None ? first : std::clamp<int64_t>(0, first, last + 1);
+	for (int64_t index = split; index <= last; index++) {
+		ensureTile({level, index}, func, bounds, symmetry, view, settings, frame, scratch, stats);
+	}
+	for (int64_t index = first; index < split; index++) {
+		ensureTile({level, index}, func, bounds, symmetry, view, settings, frame, scratch, stats);
+	}
+
+	for (int64_t index = first; index <= last; index++) {
+		// only missing if the view needs more tiles than the budget holds
+		const CurveTile* tile = find({level, index});
+		if (tile == nullptr) {
+			continue;
+		}
+		stats.yMin = std::max(stats.yMin, tile->yMin);
+		stats.yMax = std::min(stats.yMax, tile->yMax);
+		stats.pixelError = std::max(stats.pixelError, tile->pixelError);
+		stats.envelopeTiles += tile->envelope;
+
+		// neighbouring tiles share their boundary sample, unless the curve is not finite there
+		const uint32_t skip = index != first && tile->count != 0 && tile->samples[0].x == 0.0f ? 1 : 0;
+		const glm::dvec2 offset = tile->anchor - view.anchor;
+		for (uint32_t i = skip; i < tile->count; i++) {
+			const glm::vec2 sample = tile->samples[i];
+			if (isSampleBreak(sample)) {
+				stats.breaks++;
+				out.push_back(sampleBreak);
+				continue;
+			}
+			const double y = tile->anchor.y + sample.y;
+			stats.visibleSamples += view.yMin <= y && y <= view.yMax;
+			out.push_back({static_cast<float>((offset.x + sample.x) * view.outputScale),
+						   static_cast<float>((offset.y + sample.y) * view.outputScale)});
+		}
+	}
+	return stats;
+}